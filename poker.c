@@ -11,683 +11,4430 @@
  * arrive to the same conclusion.
  */
 
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PARSE_SIMD 1
+#define EVAL_SIMD 1
+#define STATS_RDTSC 1
+#endif
 
 #define POKER_FILE_PATH "poker.txt"
 #define OUTPUT_FILE_PATH "csis.txt"
-#define STR_BUF_SIZE 128
+#define DEAL_CARD_COUNT 10
+#define DEAL_LINE_LENGTH 29
+#define CARD_INVALID 0x40
+#define CHUNK_SIZE (1 << 18)
+#define OUTPUT_BUF_SIZE (1 << 21)
+#define STREAM_BUF_SIZE (1 << 24)
+#define DEAL_TEXT_MAX 256
+#define SCORE_COUNT 10
+#define STATE_CARD_SLOTS 53
+#define STATE_TABLE_PATH "poker_states.dat"
+#define STATE_TABLE_VERSION 2
+#define DEAL_FILE_VERSION 1
+#define DEAL_CARD_BITS 6
+#define BENCH_BLOCK_DEALS 1000000
+#define GENERATE_BLOCK_DEALS (1 << 18)
+#define STAGE_COUNT 6
+#define FUZZ_HAND_COUNT 8
+#define FUZZ_REPORT_MAX 1024
+#define EXHAUSTIVE_HAND_COUNT 2598960
+#define EXHAUSTIVE_BATCH 256
+#define EQUITY_TRIALS 10000000
+#define EQUITY_Z 1.96
+#define CARD_COUNT 52
+#define PLAY_CARD_COUNT 5
+#define RANK_MASK_COUNT 8192
+#define PLAY_CLASS_COUNT 7462
+#define PAIRED_BUCKET_BITS 12
+#define PAIRED_SLOT_BITS 13
 
 const int RANK_COUNT = 15;
+const int SUIT_COUNT = 4;
+const int SUIT_RANK_BITS = 13;
+const uint64_t SUIT_RANK_MASK = 0x1FFF;
+const int STRENGTH_SCORE_SHIFT = 20;
+const int STRENGTH_VAL_BITS = 4;
+// number of 5 card hands of every score, high card to royal flush
+const size_t EXHAUSTIVE_SCORE_COUNTS[SCORE_COUNT] = {1302540, 1098240, 123552, 54912, 10200,
+                                                     5108,    3744,    624,    36,    4};
+const int RANK_PRIMES[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41};
+
+/**
+ * Card parsing tables indexed by the raw rank and suit bytes of a card. A card index is
+ * RANK_VALUES[rank] + SUIT_OFFSETS[suit], and any invalid byte pushes it to CARD_INVALID or
+ * above.
+ */
+const uint8_t RANK_VALUES[256] = {
+    [0 ... 255] = CARD_INVALID,
+    ['2'] = 0, ['3'] = 1, ['4'] = 2, ['5'] = 3, ['6'] = 4, ['7'] = 5, ['8'] = 6,
+    ['9'] = 7, ['T'] = 8, ['J'] = 9, ['Q'] = 10, ['K'] = 11, ['A'] = 12,
+};
+const uint8_t SUIT_OFFSETS[256] = {
+    [0 ... 255] = CARD_INVALID,
+    ['C'] = 0, ['D'] = 13, ['H'] = 26, ['S'] = 39,
+};
+
+/**
+ * Stages of a run timed in stats builds.
+ */
+typedef enum
+{
+    STAGE_READ,
+    STAGE_PARSE,
+    STAGE_EVALUATE,
+    STAGE_COMPARE,
+    STAGE_FORMAT,
+    STAGE_WRITE,
+} Stage;
+
+/**
+ * Time spent in and number of passes through each stage, in stats_clock ticks.
+ */
+typedef struct
+{
+    uint64_t ticks[STAGE_COUNT];
+    uint64_t passes[STAGE_COUNT];
+} Stats;
+
+/**
+ * Deal outcomes from the point of view of Player, how many hands of either player made each
+ * play score and, in stats builds, where the time went.
+ */
+typedef struct
+{
+    uint64_t wins;
+    uint64_t losses;
+    uint64_t draws;
+    uint64_t score_counts[SCORE_COUNT];
+#ifdef POKER_STATS
+    Stats stats;
+#endif
+} Tally;
+
+/**
+ * Stage timers, compiled to nothing unless POKER_STATS is defined. STATS_START starts a clock
+ * and every STATS_LAP charges the ticks since the previous lap to a stage and restarts it.
+ */
+#ifdef POKER_STATS
+#define STATS_START(clock) uint64_t clock = stats_clock()
+#define STATS_LAP(stats, stage, clock)                    \
+    do                                                    \
+    {                                                     \
+        uint64_t stats_now = stats_clock();               \
+        (stats)->ticks[stage] += stats_now - (clock);     \
+        (stats)->passes[stage]++;                         \
+        (clock) = stats_now;                              \
+    } while (0)
+#else
+#define STATS_START(clock)
+#define STATS_LAP(stats, stage, clock)
+#endif
+
+/**
+ * Run settings selected on the command line, and the input format found in the input.
+ */
+typedef struct
+{
+    bool summary;
+    long threads;
+    const char *input_path;
+    const char *output_path;
+    bool binary;
+    bool stats;
+} Options;
+
+/**
+ * Text formatted once and written to every output sink in large blocks.
+ */
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t capacity;
+} OutputBuffer;
+
+/**
+ * A run of whole input lines evaluated by one worker, with the text and tally it produced.
+ */
+typedef struct
+{
+    const char *begin;
+    const char *end;
+    OutputBuffer out;
+    Tally tally;
+    bool done;
+} Chunk;
+
+/**
+ * Input split into chunks for a pool of workers. Chunk n is carved from the input in order and
+ * kept in slot n % slot_count until the main thread has written it out. While more_input is set,
+ * a reader hands over further input once pos has reached end.
+ */
+typedef struct
+{
+    const Options *options;
+    const char *pos;
+    const char *end;
+    bool more_input;
+    Chunk *chunks;
+    size_t slot_count;
+    size_t carved;
+    size_t written;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} ChunkQueue;
+
+/**
+ * Reads a stream for a ChunkQueue, filling one block buffer while the workers evaluate the
+ * block in the other one.
+ */
+typedef struct
+{
+    int fd;
+    ChunkQueue *queue;
+    Options *options;
+    char *bufs[2];
+    Tally tally;
+} StreamReader;
+
+/**
+ * A read-only memory mapping of a whole input file.
+ */
+typedef struct
+{
+    int fd;
+    const char *data;
+    size_t size;
+} InputMap;
+
+/**
+ * A set of cards packed into a single 64-bit integer. Each card occupies the bit of its
+ * card index (suit * 13 + value), so each suit owns a contiguous 13-bit rank mask.
+ */
+typedef uint64_t Hand;
 
+/**
+ * Rank masks of a hand split by multiplicity, bit n set meaning card value n appears
+ * exactly that many times.
+ */
 typedef struct
 {
-    char rank;
-    int value;
-    char suit;
-} Card;
+    uint16_t ones;
+    uint16_t twos;
+    uint16_t threes;
+    uint16_t fours;
+} RankCounts;
+
+/**
+ * Packed play strength. The score sits in bits 20-23 and the five card values, ordered by
+ * multiplicity and then by value, fill the nibbles below it, so a stronger play always
+ * compares greater.
+ */
+typedef uint32_t Strength;
 
 typedef struct
 {
     int score;
+    Strength strength;
     size_t play_val_count;
-    int *play_vals;
+    uint8_t play_vals[PLAY_CARD_COUNT];
     size_t high_val_count;
-    int *high_vals;
+    uint8_t high_vals[PLAY_CARD_COUNT];
 } Play;
 
 /**
- * Prints a formatted message to both stdout and a given file.
+ * Lookup tables of the 5 card evaluator, filled once by eval_tables_init. Each card has a
+ * word holding its rank bit (bits 16-28), suit bit (bits 12-15), value (bits 8-11) and rank
+ * prime (bits 0-7). A hand maps to one of the 7462 play classes, numbered from 1 (weakest)
+ * to PLAY_CLASS_COUNT (strongest): flushes by rank mask, other hands of five distinct values
+ * by rank mask, and hands with pairs by a perfect hash of the product of their rank primes.
+ */
+uint32_t card_words[CARD_COUNT];
+uint16_t flush_classes[RANK_MASK_COUNT];
+uint16_t unique_classes[RANK_MASK_COUNT];
+uint64_t paired_hash_mul;
+uint16_t paired_displacements[1 << PAIRED_BUCKET_BITS];
+uint16_t paired_classes[1 << PAIRED_SLOT_BITS];
+Strength class_strengths[PLAY_CLASS_COUNT + 1];
+
+/**
+ * Number of malloc, calloc and realloc calls so far, only counted in benchmark builds.
+ */
+size_t alloc_count;
+
+/**
+ * Directed state table for hands of up to 7 cards. Every set of up to 6 cards, with the suits
+ * that can no longer make a flush blanked out, is a state owning STATE_CARD_SLOTS entries from
+ * (state number + 1) * STATE_CARD_SLOTS. Slot card + 1 holds the offset of the state after
+ * adding that card, or the play class once that makes 7 cards; slot 0 of a 5 or 6 card state
+ * holds the play class of the state itself.
+ */
+typedef struct
+{
+    const uint32_t *states;
+    size_t entry_count;
+    void *map;
+    size_t map_size;
+} StateTable;
+
+/**
+ * Header of a state table file, followed by entry_count uint32_t entries.
+ */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t entry_count;
+} StateTableHeader;
+
+/**
+ * Header of a binary deal file, followed by deal_count deals of 8 bytes. A deal holds its 10
+ * card indices in DEAL_CARD_BITS bit fields from the least significant bit up, Player's cards
+ * first, stored little endian.
+ */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t deal_count;
+} DealFileHeader;
+
+/**
+ * One block of random deals produced by a generator thread. Every block draws from its own
+ * random sequence derived from the seed and the block number, so the output only depends on
+ * the seed, never on the number of threads.
+ */
+typedef struct
+{
+    uint64_t seed;
+    size_t block;
+    size_t deal_count;
+    bool binary;
+    OutputBuffer out;
+} GenerateJob;
+
+/**
+ * Work of one differential fuzzing thread: random deals from its own seed until the deal limit,
+ * the time limit or a divergence on any thread.
+ */
+typedef struct
+{
+    uint64_t seed;
+    size_t deal_limit;
+    double end_time;
+    const StateTable *table;
+    size_t deals_checked;
+    bool diverged;
+    char report[FUZZ_REPORT_MAX];
+} FuzzJob;
+
+/**
+ * Work of one exhaustive thread: a run of consecutive 5 card hands in lexicographic order,
+ * either only evaluated and counted by score, or also checked against every other evaluator.
+ */
+typedef struct
+{
+    size_t first;
+    size_t hand_count;
+    bool check;
+    size_t score_counts[SCORE_COUNT];
+    size_t mismatches;
+    uint8_t first_mismatch[PLAY_CARD_COUNT];
+} ExhaustiveJob;
+
+/**
+ * Work of one equity thread: trials that complete Other's hand from the cards left in the deck,
+ * each compared with Player's fixed hand.
+ */
+typedef struct
+{
+    uint64_t seed;
+    size_t trials;
+    uint16_t player_class;
+    uint8_t other[PLAY_CARD_COUNT];
+    size_t other_known;
+    uint8_t deck[CARD_COUNT];
+    size_t deck_count;
+    size_t wins;
+    size_t ties;
+    size_t losses;
+} EquityJob;
+
+/**
+ * Parses the command line arguments, printing the usage and exiting on invalid ones.
  * 
- * @param fp file pointer for printing out to
- * @param formatted_message formatted print message
- * @param ... variadic arglist for fromatted printing
+ * @param argc number of arguments
+ * @param argv argument strings
+ * @return Options resulting run settings
  */
-void csis_printf(FILE *fp, const char *formatted_message, ...);
+Options options_parse(int argc, char const *argv[]);
 
 /**
- * Converts a card rank to the cooresponding integer value.
+ * Returns the default number of threads, one per online CPU and at least one.
  * 
- * @param rank rank of the card
- * @return int cooresponding integer value
+ * @return long number of threads
  */
-int rank_to_value(char rank);
+long threads_default(void);
 
 /**
- * Converts a card integer value to the cooresponding rank.
+ * Parses a -j or --threads option at argv[*i], moving i past its count.
  * 
- * @param value integer value of the card
- * @return char cooresponding rank
+ * @param argc number of arguments
+ * @param argv argument strings
+ * @param i index of the argument to look at
+ * @param threads number of threads to set, left alone unless the option is valid
+ * @return true the argument is a thread option with a positive count
+ * @return false the argument is something else, or the count is missing or not positive
  */
-char value_to_rank(int value);
+bool threads_option(int argc, char const *argv[], int *i, long *threads);
 
 /**
- * Converts a given amount of the same card into the number pairs it represents.
+ * Adds the outcome of one deal to a tally.
  * 
- * @param count number of instances of the same card
- * @return int numberr of pairs the count represents
+ * @param tally tally to update
+ * @param player strength of the play of Player
+ * @param other strength of the play of Other
  */
-int count_to_n_pairs(int count);
+void tally_add(Tally *tally, Strength player, Strength other);
 
 /**
- * Converts a number of card pairs to the cooresponding integer score value representing the play.
+ * Adds the counts of one tally to another.
  * 
- * @param n_pairs number of pairs
- * @return int score integer value representing the play
+ * @param tally tally to update
+ * @param other tally to add
  */
-int n_pairs_to_score(int n_pairs);
+void tally_merge(Tally *tally, const Tally *other);
 
 /**
- * Converts a play score to the cooresponding string representation of that play.
+ * Returns the end of the chunk starting at the given position, at the first line boundary
+ * CHUNK_SIZE bytes or more into the input, or exactly CHUNK_SIZE bytes in for binary deals.
  * 
- * @param score integer play score
- * @return char* string representing the play
+ * @param pos start of the chunk
+ * @param end end of the input
+ * @param binary the input holds binary deals
+ * @return const char* end of the chunk
  */
-char *score_to_play_string(int score);
+const char *chunk_boundary(const char *pos, const char *end, bool binary);
 
 /**
- * Creates a card structure from the given rank and suit.
+ * Evaluates every deal of a chunk, replacing its text and tally with the results. Deals with an
+ * invalid or a repeated card are skipped.
  * 
- * @param rank rank of the card
- * @param suit suit of the card
- * @return Card the created card structure
+ * @param chunk chunk to process
+ * @param options run settings
  */
-Card card_make(char rank, char suit);
+void process_chunk(Chunk *chunk, const Options *options);
 
 /**
- * Returns an array containing the integer values of the cards contained in a given array of card structures.
+ * Worker thread body: processes chunks from a queue until the input is exhausted.
  * 
- * @param card_count number of cards
- * @param cards array of cards
- * @return int* array of integer card values
+ * @param arg the ChunkQueue
+ * @return void* always NULL
  */
-int *cards_get_values(size_t card_count, Card *cards);
+void *chunk_worker(void *arg);
 
 /**
- * Returns an array containing the suits of the cards contained in a given of card structures.
+ * Runs a pool of queue->options->threads workers over a chunk queue and writes the text of the
+ * chunks to every sink in input order until the queue has no more input.
  * 
- * @param card_count number of cards
- * @param cards array of cards
- * @return char* array of suit characters
+ * @param queue queue holding the input and its lock, condition and options
+ * @param fds file descriptors of the sinks
+ * @param fd_count number of sinks
+ * @return Tally tally of every deal
  */
-char *cards_get_suits(size_t card_count, Card *cards);
+Tally run_queue(ChunkQueue *queue, const int *fds, size_t fd_count);
 
 /**
- * Returns an array where the index is the card integer value and the value of the int at a given
- * index is the number of times that card was contained in the given array of cards.
+ * Evaluates every deal of the input on options->threads threads and writes the text of each
+ * deal to every sink in input order.
  * 
- * @param card_count number of cards
- * @param cards array of cards
- * @return int* array of card integer value counts
+ * @param begin start of the input
+ * @param end end of the input
+ * @param options run settings
+ * @param fds file descriptors of the sinks
+ * @param fd_count number of sinks
+ * @return Tally tally of every deal
  */
-int *cards_get_value_counts(size_t card_count, Card *cards);
+Tally run_deals(const char *begin, const char *end, const Options *options, const int *fds, size_t fd_count);
 
 /**
- * Determines the pairs in the given array of cards and returns the cooresponding play structure
- * using only pair information.
+ * Reader thread body: reads a stream STREAM_BUF_SIZE bytes at a time into the two buffers of a
+ * StreamReader by turns and hands the whole lines or deals of each block to its queue.
  * 
- * @param card_count number of cards
- * @param cards array of cards
- * @return Play play structure using only pair information
+ * @param arg the StreamReader
+ * @return void* always NULL
  */
-Play calc_pairs(size_t card_count, Card *cards);
+void *stream_reader(void *arg);
 
 /**
- * Return whether or not the given array of card structures is a straight.
+ * Evaluates every deal read from a stream such as a pipe, STREAM_BUF_SIZE bytes at a time, and
+ * writes the text of each deal to every sink in input order. The next block is read while the
+ * workers evaluate the current one.
  * 
- * @param card_count number of cards
- * @param cards array of cards
- * @return true array of cards contains a straight
- * @return false array of cards does not contain a straight
+ * @param fd file descriptor to read until end of file
+ * @param options run settings
+ * @param fds file descriptors of the sinks
+ * @param fd_count number of sinks
+ * @return Tally tally of every deal
  */
-bool is_straight(size_t card_count, Card *cards);
+Tally run_stream(int fd, const Options *options, const int *fds, size_t fd_count);
 
 /**
- * Return whether or not the given array of card structures is a flush.
+ * Appends the win, loss and draw counts and the play score histogram of a tally to an
+ * output buffer.
  * 
- * @param card_count number of cards
- * @param cards array of cards
- * @return true array of cards contains a flush
- * @return false array of cards does not contain a flush
+ * @param out output buffer
+ * @param tally tally to describe
  */
-bool is_flush(size_t card_count, Card *cards);
+void output_summary(OutputBuffer *out, Tally *tally);
 
 /**
- * Return whether or not the given array of card structures is a royal flush.
+ * Appends the stage timings of a run and its play score distribution to an output buffer.
+ * The timings are only there in builds with POKER_STATS defined, and only for the stages the
+ * run went through.
  * 
- * @param card_count number of cards
- * @param cards array of cards
- * @return true array of cards contains a royal flush
- * @return false array of cards does not contain a royal flush
+ * @param out output buffer
+ * @param tally tally of the run
+ * @param seconds wall clock time of the run
+ * @param ticks stats_clock ticks of the run
  */
-bool is_royal(size_t card_count, Card *cards);
+void output_stats(OutputBuffer *out, Tally *tally, double seconds, uint64_t ticks);
 
 /**
- * Returns a play structure representing the best play that an array of cards can make.
+ * Returns a fast running tick count for the stage timers: the time stamp counter on x86 and
+ * nanoseconds elsewhere.
  * 
- * @param card_count number of cards
- * @param cards array of cards
- * @return Play resulting play structure
+ * @return uint64_t tick count
  */
-Play calculate_play(size_t card_count, Card *cards);
+uint64_t stats_clock(void);
 
 /**
- * Compares the high cards between two play structures.
+ * Creates an empty output buffer.
  * 
- * @param a left hand side play
- * @param b right hand side play
- * @return int negative = a lost, zero = draw, positive = a won
+ * @param capacity number of bytes the buffer can hold
+ * @return OutputBuffer the created output buffer
  */
-int high_vals_cmp(Play *a, Play *b);
+OutputBuffer output_buffer_make(size_t capacity);
 
 /**
- * Compares the play cards between two play structures.
+ * Releases the memory held by an output buffer.
  * 
- * @param a left hand side play
- * @param b right hand side play
- * @return int negative = a lost, zero = draw, positive = a won
+ * @param out output buffer
  */
-int play_vals_cmp(Play *a, Play *b);
+void output_buffer_free(OutputBuffer *out);
 
 /**
- * Compares two play structures.
+ * Grows an output buffer so that it can take at least the given number of further bytes.
  * 
- * @param a left hand side play
- * @param b right hand side play
- * @return int negative = a lost, zero = draw, positive = a won
+ * @param out output buffer
+ * @param len number of bytes to make room for
  */
-int play_cmp(Play *a, Play *b);
+void output_reserve(OutputBuffer *out, size_t len);
 
-int main(int argc, char const *argv[])
-{
-    FILE *fp_in = fopen(POKER_FILE_PATH, "r");
-    if (fp_in == NULL)
-    {
-        printf("Could not open %s for input.", POKER_FILE_PATH);
-        exit(EXIT_FAILURE);
-    }
+/**
+ * Appends a string to an output buffer.
+ * 
+ * @param out output buffer
+ * @param str string to append
+ */
+void output_str(OutputBuffer *out, const char *str);
 
-    FILE *fp_out = fopen(OUTPUT_FILE_PATH, "w");
-    if (fp_out == NULL)
-    {
-        printf("Could not open %s for input.", OUTPUT_FILE_PATH);
-        exit(EXIT_FAILURE);
-    }
+/**
+ * Appends a formatted message to an output buffer, growing the buffer as needed.
+ * 
+ * @param out output buffer
+ * @param formatted_message formatted print message
+ * @param ... variadic arglist for fromatted printing
+ */
+void output_printf(OutputBuffer *out, const char *formatted_message, ...);
 
-    int result = 0;
+/**
+ * Appends the description line of one player's hand and play to an output buffer.
+ * 
+ * @param out output buffer
+ * @param label player label starting the line
+ * @param cards the five card indices of the hand
+ * @param play play made by the hand
+ */
+void output_play(OutputBuffer *out, const char *label, const uint8_t *cards, Play *play);
 
-    char line[STR_BUF_SIZE];
-    while (fgets(line, STR_BUF_SIZE, fp_in))
-    {
-        Card line_cards[10];
+/**
+ * Writes the whole content of an output buffer to every sink and empties it.
+ * 
+ * @param out output buffer
+ * @param fds file descriptors of the sinks
+ * @param fd_count number of sinks
+ */
+void output_write(OutputBuffer *out, const int *fds, size_t fd_count);
 
-        size_t card_idx = 0, char_idx = 0;
-        while (char_idx < strlen(line))
-        {
-            line_cards[card_idx++] = card_make(line[char_idx], line[char_idx + 1]);
-            char_idx += 3;
-        }
+/**
+ * Maps a whole file into memory for sequential reading.
+ * 
+ * @param path path of the file to map
+ * @param input resulting mapping, data is NULL for an empty file
+ * @return true the file was mapped
+ * @return false the file could not be opened or mapped
+ */
+bool input_map_open(const char *path, InputMap *input);
 
-        Play player_play = calculate_play(5, &line_cards[0]);
-        Play other_play = calculate_play(5, &line_cards[5]);
+/**
+ * Unmaps and closes a file mapped by input_map_open.
+ * 
+ * @param input mapping to release
+ */
+void input_map_close(InputMap *input);
 
-        bool player_won = play_cmp(&player_play, &other_play) > 0;
-        result += player_won;
+/**
+ * Parses the cards of one deal line straight out of a text buffer, leaving the position at
+ * the start of the next line.
+ * 
+ * @param pos position of the line, advanced past its newline
+ * @param end end of the buffer
+ * @param cards array of at least DEAL_CARD_COUNT card indices to fill
+ * @return size_t number of valid cards parsed before the first invalid one
+ */
+size_t parse_deal(const char **pos, const char *end, uint8_t *cards);
 
-        // formatted printing mess belows
+/**
+ * Parses a deal line like parse_deal with the scalar table lookups only, the fallback of the
+ * SIMD path and its reference.
+ * 
+ * @param pos position of the line, advanced past its newline
+ * @param end end of the buffer
+ * @param cards array of at least DEAL_CARD_COUNT card indices to fill
+ * @return size_t number of valid cards parsed before the first invalid one
+ */
+size_t parse_deal_scalar(const char **pos, const char *end, uint8_t *cards);
 
-        csis_printf(fp_out, "(Player) ");
+#ifdef PARSE_SIMD
+/**
+ * Parses a deal line in the fixed 29 byte layout with SSE4.1, translating every rank and suit
+ * with in-register table lookups. Reads 32 bytes starting at the line.
+ * 
+ * @param line start of the line, at least 32 readable bytes
+ * @param cards array of at least DEAL_CARD_COUNT card indices to fill
+ * @return true the line holds ten valid cards followed by a newline
+ * @return false the line must be parsed by the scalar path
+ */
+bool parse_deal_sse41(const char *line, uint8_t *cards);
+#endif
 
-        for (size_t i = 0; i < 4; i++)
-            csis_printf(fp_out, "%c ", value_to_rank(line_cards[i].value));
-        csis_printf(fp_out, "%c", value_to_rank(line_cards[5].value));
+/**
+ * Packs the card indices of a deal into its binary form.
+ * 
+ * @param cards array of DEAL_CARD_COUNT card indices
+ * @return uint64_t binary deal
+ */
+uint64_t deal_pack(const uint8_t *cards);
 
-        csis_printf(fp_out, ", Play = %s", score_to_play_string(player_play.score));
+/**
+ * Unpacks one binary deal, leaving the position at the next deal.
+ * 
+ * @param pos position of the deal, advanced past it
+ * @param cards array of at least DEAL_CARD_COUNT card indices to fill
+ * @return size_t number of valid cards before the first invalid one
+ */
+size_t deal_unpack(const char **pos, uint8_t *cards);
 
-        if (player_play.play_val_count)
-        {
-            csis_printf(fp_out, ", Play cards = ");
-            for (size_t i = 0; i < player_play.play_val_count - 1; i++)
-                csis_printf(fp_out, "%c ", value_to_rank(player_play.play_vals[i]));
-            csis_printf(fp_out, "%c", value_to_rank(player_play.play_vals[player_play.play_val_count - 1]));
-        }
+/**
+ * Checks whether a buffer starts with a binary deal file header.
+ * 
+ * @param data start of the buffer
+ * @param size number of bytes in the buffer
+ * @return true the buffer starts with a header of this version
+ * @return false the buffer holds text deals
+ */
+bool deal_file_is_binary(const char *data, size_t size);
 
-        if (player_play.high_val_count)
-        {
-            csis_printf(fp_out, ", High cards = ");
-            for (size_t i = 0; i < player_play.high_val_count; i++)
-                csis_printf(fp_out, "%c ", value_to_rank(player_play.high_vals[i]));
-        }
+/**
+ * Checks whether the deal count in the header of a binary deal file matches the size of the file,
+ * which a truncated or padded file does not.
+ * 
+ * @param data start of the file, a binary deal file header
+ * @param size number of bytes in the file
+ * @return true the file holds exactly the deals its header counts
+ * @return false the file is longer or shorter than its header says
+ */
+bool deal_file_count_matches(const char *data, size_t size);
 
-        csis_printf(fp_out, "\n");
+/**
+ * Entry point of the convert subcommand: converts a deal file from text to binary or from
+ * binary to text, whichever it is not.
+ * 
+ * @param argc number of arguments
+ * @param argv argument strings, argv[0] being the subcommand
+ * @return int process exit status
+ */
+int convert_main(int argc, char const *argv[]);
 
-        csis_printf(fp_out, "(Other)  ");
+/**
+ * Writes the rank and suit characters of a card, as found in poker.txt.
+ * 
+ * @param card valid card index
+ * @param text buffer of at least 2 bytes, not NUL terminated
+ */
+void card_format(uint8_t card, char *text);
 
-        for (size_t i = 5; i < 9; i++)
-            csis_printf(fp_out, "%c ", value_to_rank(line_cards[i].value));
-        csis_printf(fp_out, "%c", value_to_rank(line_cards[10].value));
+/**
+ * Writes the text line of a deal, as found in poker.txt, newline included.
+ * 
+ * @param cards array of DEAL_CARD_COUNT valid card indices
+ * @param line buffer of at least DEAL_LINE_LENGTH + 1 bytes
+ * @return size_t number of bytes written
+ */
+size_t deal_format(const uint8_t *cards, char *line);
 
-        csis_printf(fp_out, ", Play = %s", score_to_play_string(other_play.score));
+/**
+ * Returns the time of a monotonic clock.
+ * 
+ * @return double time in seconds
+ */
+double time_now(void);
 
-        if (other_play.play_val_count)
-        {
-            csis_printf(fp_out, ", Play cards = ");
-            for (size_t i = 0; i < other_play.play_val_count - 1; i++)
-                csis_printf(fp_out, "%c ", value_to_rank(other_play.play_vals[i]));
-            csis_printf(fp_out, "%c", value_to_rank(other_play.play_vals[other_play.play_val_count - 1]));
-        }
+/**
+ * Prints one line of benchmark results.
+ * 
+ * @param name name of the benchmark
+ * @param unit name of one operation
+ * @param op_count number of operations timed
+ * @param seconds time taken
+ * @param allocs number of allocations made
+ */
+void bench_report(const char *name, const char *unit, size_t op_count, double seconds, size_t allocs);
 
-        if (other_play.high_val_count)
-        {
-            csis_printf(fp_out, ", High cards = ");
-            for (size_t i = 0; i < other_play.high_val_count; i++)
-                csis_printf(fp_out, "%c ", value_to_rank(other_play.high_vals[i]));
-        }
+/**
+ * Entry point of the bench subcommand: times the parse, evaluate, compare and format stages on
+ * random deals, then whole runs over corpora of the given numbers of deals.
+ * 
+ * @param argc number of arguments
+ * @param argv argument strings, argv[0] being the subcommand, then corpus sizes in deals
+ * @return int process exit status
+ */
+int bench_main(int argc, char const *argv[]);
 
-        csis_printf(fp_out, "\n%s won!\n\n", player_won ? "Player" : "Other");
-    }
+/**
+ * Worker thread body: fills the output buffer of a GenerateJob with its block of deals.
+ * 
+ * @param arg the GenerateJob
+ * @return void* always NULL
+ */
+void *generate_worker(void *arg);
 
-    csis_printf(fp_out, "Player won %d times!\n", result);
+/**
+ * Entry point of the generate subcommand: writes a reproducible corpus of random deals in the
+ * text format of poker.txt or in the binary deal format.
+ * 
+ * @param argc number of arguments
+ * @param argv argument strings, argv[0] being the subcommand
+ * @return int process exit status
+ */
+int generate_main(int argc, char const *argv[]);
 
-    fclose(fp_out);
-    fclose(fp_in);
-}
+/**
+ * Returns the strength of a 5 card hand the plain way, sorting the card values and counting
+ * them, with none of the tables or bit tricks of the other evaluators, so that it can serve as
+ * their reference. Values are ordered by how often they appear, then by value, which puts the
+ * three of a kind of a full house ahead of its pair. The ace of the wheel A-2-3-4-5 counts low,
+ * so the wheel is a straight with the 5 as its top, below every other straight.
+ * 
+ * @param cards array of 5 distinct card indices
+ * @return Strength strength of the play
+ */
+Strength reference_strength(const uint8_t *cards);
 
-void csis_printf(FILE *fp, const char *formatted_message, ...)
-{
-    va_list arglist;
+/**
+ * Returns the strength of the best 5 card play within up to 7 cards by trying every 5 card
+ * subset with reference_strength, the reference for the evaluators of larger hands.
+ * 
+ * @param card_count number of cards, 5 to 7
+ * @param cards array of card indices
+ * @return Strength strength of the best play
+ */
+Strength best_subset_strength(size_t card_count, const uint8_t *cards);
 
-    va_start(arglist, formatted_message);
-    vprintf(formatted_message, arglist);
-    va_end(arglist);
+/**
+ * Runs one deal of 10 distinct cards through every evaluator and compares them with the
+ * reference, reference_strength on the 5 card hands and best_subset_strength on hands of 6 and
+ * 7 cards taken from the deal.
+ * 
+ * @param cards array of DEAL_CARD_COUNT distinct card indices
+ * @param table state table to check as well, or NULL
+ * @param report buffer of FUZZ_REPORT_MAX bytes for the description of a divergence
+ * @return true every evaluator agrees
+ * @return false some evaluator diverged, as described in the report
+ */
+bool fuzz_check_deal(const uint8_t *cards, const StateTable *table, char *report);
 
-    va_start(arglist, formatted_message);
-    vfprintf(fp, formatted_message, arglist);
-    va_end(arglist);
-}
+/**
+ * Parses the line at a position with both the SSE4.1 and the scalar parser and compares them:
+ * both must agree on the cards of every line in the fixed layout and the SIMD path must reject
+ * every other line. Lines with less than 32 readable bytes only go through the scalar parser.
+ * 
+ * @param line start of the line
+ * @param end end of the buffer
+ * @param report buffer of FUZZ_REPORT_MAX bytes for the description of a divergence
+ * @return true the parsers agree
+ * @return false the parsers diverged, as described in the report
+ */
+bool fuzz_check_parse(const char *line, const char *end, char *report);
 
-void counting_sort(int *vals, int size, int el_max, bool reverse)
-{
-    int *counts = calloc(el_max, sizeof(int));
+/**
+ * Worker thread body: checks random deals for a FuzzJob.
+ * 
+ * @param arg the FuzzJob
+ * @return void* always NULL
+ */
+void *fuzz_worker(void *arg);
 
-    for (int i = 0; i < size; i++)
-        counts[vals[i]]++;
+/**
+ * Entry point of the fuzz subcommand: checks random deals on every thread until a limit is
+ * reached or an evaluator diverges from the reference.
+ * 
+ * @param argc number of arguments
+ * @param argv argument strings, argv[0] being the subcommand
+ * @return int process exit status, failure on a divergence
+ */
+int fuzz_main(int argc, char const *argv[]);
+
+/**
+ * Sets cards to the combination of k out of 0 to n - 1 with the given rank in lexicographic
+ * order, so that threads can each start at their own share of the combinations.
+ * 
+ * @param rank index of the combination, below n choose k
+ * @param k number of elements chosen
+ * @param n number of elements to choose from
+ * @param cards array of k elements for the combination, ascending
+ */
+void combination_unrank(size_t rank, size_t k, size_t n, uint8_t *cards);
+
+/**
+ * Advances cards to the next combination of k out of 0 to n - 1 in lexicographic order.
+ * 
+ * @param cards array of k ascending elements
+ * @param k number of elements chosen
+ * @param n number of elements to choose from
+ * @return true cards holds the next combination
+ * @return false cards held the last combination
+ */
+bool combination_next(uint8_t *cards, size_t k, size_t n);
+
+/**
+ * Worker thread body: evaluates the hands of an ExhaustiveJob.
+ * 
+ * @param arg the ExhaustiveJob
+ * @return void* always NULL
+ */
+void *exhaustive_worker(void *arg);
+
+/**
+ * Entry point of the exhaustive subcommand: evaluates every 5 card hand, checks the number of
+ * hands of every score and cross checks every evaluator and the is_straight, is_flush and
+ * is_royal predicates against reference_strength.
+ * 
+ * @param argc number of arguments
+ * @param argv argument strings, argv[0] being the subcommand
+ * @return int process exit status, failure on a wrong count or a mismatch
+ */
+int exhaustive_main(int argc, char const *argv[]);
+
+/**
+ * Parses a command line list of cards such as "AS KD 7C", separated by spaces or commas.
+ * 
+ * @param text card list
+ * @param cards array of max_count card indices to fill
+ * @param max_count largest number of cards accepted
+ * @param used cards taken already, updated with the parsed cards
+ * @return int number of cards parsed, -1 on an invalid, repeated or extra card
+ */
+int cards_parse_arg(const char *text, uint8_t *cards, int max_count, Hand *used);
+
+/**
+ * Worker thread body: runs the trials of an EquityJob.
+ * 
+ * @param arg the EquityJob
+ * @return void* always NULL
+ */
+void *equity_worker(void *arg);
+
+/**
+ * Prints one outcome of the equity subcommand as a percentage with its Wilson score interval,
+ * which unlike the normal approximation stays wide enough at shares of 0 and 1.
+ * 
+ * @param name name of the outcome
+ * @param mean share of the trials, 0 to 1
+ * @param trials number of trials
+ */
+void equity_report(const char *name, double mean, size_t trials);
+
+/**
+ * Entry point of the equity subcommand: estimates Player's chances against an Other hand that is
+ * partly or wholly unknown by dealing the unknown cards at random from the rest of the deck.
+ * 
+ * @param argc number of arguments
+ * @param argv argument strings, argv[0] being the subcommand
+ * @return int process exit status
+ */
+int equity_main(int argc, char const *argv[]);
+
+#ifdef POKER_FUZZER
+/**
+ * libFuzzer initialisation hook, run once before any input: builds the evaluator tables.
+ * 
+ * @param argc pointer to the number of fuzzer arguments
+ * @param argv pointer to the fuzzer arguments
+ * @return int always 0
+ */
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+
+/**
+ * libFuzzer entry point, also usable from AFL++: parses the input as deal text, checking the
+ * SIMD parser against the scalar one on every line and the evaluators on every deal of 10
+ * distinct cards, and aborts on a divergence.
+ * 
+ * @param data fuzzer input
+ * @param size number of bytes of input
+ * @return int always 0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+#endif
+
+/**
+ * Converts a card rank to the cooresponding integer value.
+ * 
+ * @param rank rank of the card
+ * @return int cooresponding integer value
+ */
+int rank_to_value(char rank);
+
+/**
+ * Converts a card integer value to the cooresponding rank.
+ * 
+ * @param value integer value of the card
+ * @return char cooresponding rank
+ */
+char value_to_rank(int value);
+
+/**
+ * Converts a given amount of the same card into the number pairs it represents.
+ * 
+ * @param count number of instances of the same card
+ * @return int numberr of pairs the count represents
+ */
+int count_to_n_pairs(int count);
+
+/**
+ * Converts a number of card pairs to the cooresponding integer score value representing the play.
+ * 
+ * @param n_pairs number of pairs
+ * @return int score integer value representing the play
+ */
+int n_pairs_to_score(int n_pairs);
+
+/**
+ * Converts a play score to the cooresponding string representation of that play.
+ * 
+ * @param score integer play score
+ * @return char* string representing the play
+ */
+char *score_to_play_string(int score);
+
+/**
+ * Converts a play score to the number of play cards that play is made of.
+ * 
+ * @param score integer play score
+ * @return size_t number of play cards
+ */
+size_t score_to_play_val_count(int score);
+
+/**
+ * Converts a play score to the number of high cards that accompany the play cards.
+ * 
+ * @param score integer play score
+ * @return size_t number of high cards
+ */
+size_t score_to_high_val_count(int score);
+
+/**
+ * Converts a two character card token to its index in a 52 card deck (suit * 13 + value).
+ * 
+ * @param rank rank of the card
+ * @param suit suit of the card
+ * @return uint8_t cooresponding card index, CARD_INVALID or above for an invalid card
+ */
+uint8_t card_parse(char rank, char suit);
+
+/**
+ * Returns the integer value of a card index.
+ * 
+ * @param card card index
+ * @return int cooresponding integer value
+ */
+int card_value(uint8_t card);
+
+/**
+ * Creates a hand bitmask from the given array of card indices.
+ * 
+ * @param card_count number of cards
+ * @param cards array of card indices
+ * @return Hand bitmask containing every card
+ */
+Hand hand_make(size_t card_count, const uint8_t *cards);
+
+/**
+ * Returns the 13-bit rank mask of the cards of a single suit in a hand.
+ * 
+ * @param hand hand bitmask
+ * @param suit suit index
+ * @return uint16_t rank mask of that suit
+ */
+uint16_t hand_suit_ranks(Hand hand, int suit);
+
+/**
+ * Returns the rank masks of a hand split by how many times each rank appears.
+ * 
+ * @param hand hand bitmask
+ * @return RankCounts rank masks by multiplicity
+ */
+RankCounts hand_get_rank_counts(Hand hand);
+
+/**
+ * Determines the pairs in the given hand and returns the cooresponding strength using only
+ * pair information.
+ * 
+ * @param hand hand bitmask
+ * @return Strength strength using only pair information
+ */
+Strength calc_pairs(Hand hand);
+
+/**
+ * Return whether or not the given 5 card hand is a straight, the wheel A-2-3-4-5 included.
+ * 
+ * @param hand hand bitmask
+ * @return true hand contains a straight
+ * @return false hand does not contain a straight
+ */
+bool is_straight(Hand hand);
+
+/**
+ * Return whether or not the given hand is a flush.
+ * 
+ * @param hand hand bitmask
+ * @return true hand contains a flush
+ * @return false hand does not contain a flush
+ */
+bool is_flush(Hand hand);
+
+/**
+ * Return whether or not the given hand is a royal flush.
+ * 
+ * @param hand hand bitmask
+ * @return true hand contains a royal flush
+ * @return false hand does not contain a royal flush
+ */
+bool is_royal(Hand hand);
+
+/**
+ * Returns the packed strength of the best play that a hand can make.
+ * 
+ * @param hand hand bitmask
+ * @return Strength resulting play strength
+ */
+Strength hand_strength(Hand hand);
+
+/**
+ * Returns the highest card value of every run of five consecutive values in a rank mask, the
+ * ace also counting below the 2 so that the wheel A-2-3-4-5 has the 5 as its top.
+ * 
+ * @param ranks rank mask
+ * @return uint16_t rank mask of the top values of the runs
+ */
+uint16_t straight_tops(uint16_t ranks);
+
+/**
+ * Returns the packed values of a straight, the wheel ending with its ace.
+ * 
+ * @param top highest card value of the straight
+ * @return Strength packed values of the five cards
+ */
+Strength straight_vals(int top);
+
+/**
+ * Appends one card value a number of times to the packed values of a strength.
+ * 
+ * @param vals packed values so far
+ * @param value card value to append
+ * @param count number of times to append it
+ * @return Strength packed values with the value appended
+ */
+Strength vals_push(Strength vals, int value, int count);
+
+/**
+ * Appends the highest card values of a rank mask to the packed values of a strength.
+ * 
+ * @param vals packed values so far
+ * @param ranks rank mask to take the values from
+ * @param count number of values to append
+ * @return Strength packed values with the values appended
+ */
+Strength vals_push_top(Strength vals, uint16_t ranks, int count);
+
+/**
+ * Returns the packed strength of the best 5 card play within a hand of 5 to 7 cards, such as
+ * a player's hole cards combined with the board, without going through its 5 card subsets.
+ * 
+ * @param hand hand bitmask
+ * @return Strength strength of the best play
+ */
+Strength hand_best_strength(Hand hand);
+
+/**
+ * Computes the strengths of the best plays of many hands of 5 to 7 cards, as hand_best_strength
+ * would, 8 hands at a time with AVX2 when the processor supports it.
+ * 
+ * @param hands array of hand bitmasks
+ * @param strengths array of resulting strengths, one per hand
+ * @param n number of hands
+ */
+void evaluate_batch(const uint64_t *hands, uint32_t *strengths, size_t n);
+
+#ifdef EVAL_SIMD
+/**
+ * Computes the strengths of 8 hands of 5 to 7 cards with AVX2. Each hand is split into its four
+ * suit masks with one hand per 32 bit lane, so that rank counts, flush and straight masks and
+ * the packed values of every category are computed for all 8 hands in the same instructions.
+ * 
+ * @param hands array of 8 hand bitmasks
+ * @param strengths array of 8 resulting strengths
+ */
+void evaluate8_avx2(const uint64_t *hands, uint32_t *strengths);
+
+/**
+ * Returns the number of set bits of every 32 bit lane.
+ * 
+ * @param x lanes to count
+ * @return __m256i bit counts
+ */
+__m256i popcount8(__m256i x);
+
+/**
+ * Returns the index of the highest set bit of every lane, read from the exponent of its
+ * conversion to float. Exact for lanes below 2^24; zero lanes give a negative index.
+ * 
+ * @param x lanes to scan
+ * @return __m256i bit indices
+ */
+__m256i top_bit8(__m256i x);
+
+/**
+ * Returns straight_tops of every lane.
+ * 
+ * @param ranks rank masks
+ * @return __m256i masks of the top values of every run of five values
+ */
+__m256i straight_tops8(__m256i ranks);
+#endif
+
+/**
+ * Returns the play score held in a packed strength.
+ * 
+ * @param strength packed play strength
+ * @return int integer play score
+ */
+int strength_to_score(Strength strength);
+
+/**
+ * Unpacks a strength into the cooresponding play structure.
+ * 
+ * @param strength packed play strength
+ * @return Play resulting play structure
+ */
+Play strength_to_play(Strength strength);
+
+/**
+ * Returns a play structure representing the best play that a hand can make.
+ * 
+ * @param hand hand bitmask
+ * @return Play resulting play structure
+ */
+Play calculate_hand_play(Hand hand);
+
+/**
+ * Fills the lookup tables of the 5 card evaluator from the rules in hand_strength. Must be
+ * called once before calculate_play or eval5_class are used.
+ */
+void eval_tables_init(void);
+
+/**
+ * Returns the slot of the paired hand table belonging to a product of rank primes.
+ * 
+ * @param prime_product product of the rank primes of the five cards
+ * @return uint32_t cooresponding slot in paired_classes
+ */
+uint32_t paired_slot(uint32_t prime_product);
+
+/**
+ * Returns the play class of a 5 card hand using only table lookups.
+ * 
+ * @param a index of the first card
+ * @param b index of the second card
+ * @param c index of the third card
+ * @param d index of the fourth card
+ * @param e index of the fifth card
+ * @return uint16_t play class, higher is stronger
+ */
+uint16_t eval5_class(int a, int b, int c, int d, int e);
+
+/**
+ * Returns the packed strength of the best play that an array of cards can make.
+ * 
+ * @param card_count number of cards
+ * @param cards array of card indices
+ * @return Strength resulting play strength
+ */
+Strength calculate_strength(size_t card_count, const uint8_t *cards);
+
+/**
+ * Returns a play structure representing the best play that an array of cards can make.
+ * 
+ * @param card_count number of cards
+ * @param cards array of card indices
+ * @return Play resulting play structure
+ */
+Play calculate_play(size_t card_count, const uint8_t *cards);
+
+/**
+ * Compares two play structures.
+ * 
+ * @param a left hand side play
+ * @param b right hand side play
+ * @return int negative = a lost, zero = draw, positive = a won
+ */
+int play_cmp(Play *a, Play *b);
+
+/**
+ * Returns the next number of a splitmix64 pseudo random sequence.
+ * 
+ * @param state generator state, advanced by one step
+ * @return uint64_t pseudo random number
+ */
+uint64_t rng_next(uint64_t *state);
+
+/**
+ * Deals distinct random cards.
+ * 
+ * @param rng generator state
+ * @param card_count number of cards to deal
+ * @param cards array of card indices to fill
+ * @return Hand bitmask of the dealt cards
+ */
+Hand deal_random(uint64_t *rng, size_t card_count, uint8_t *cards);
+
+/**
+ * Moves random cards of a deck to its front with a partial Fisher-Yates shuffle, drawing two
+ * cards per random number. The rest of the deck stays shuffled, so dealing again from the same
+ * deck stays uniform.
+ * 
+ * @param deck array of card indices, shuffled in place
+ * @param deck_count number of cards in the deck
+ * @param n number of cards to deal, at most deck_count
+ * @param rng generator state
+ */
+void deck_deal_partial(uint8_t *deck, size_t deck_count, size_t n, uint64_t *rng);
+
+/**
+ * Returns the starting state of the random sequence of one thread or block, far apart from the
+ * sequences of the others for the same seed.
+ * 
+ * @param seed seed of the whole run
+ * @param index index of the thread or block
+ * @return uint64_t generator state
+ */
+uint64_t thread_seed(uint64_t seed, uint64_t index);
+
+/**
+ * Adds a card to a state id, a descending list of up to 7 card bytes holding (value + 1) << 4
+ * and suit + 1, or no suit once that suit can no longer make a flush.
+ * 
+ * @param id state id
+ * @param card index of the card to add
+ * @return uint64_t resulting state id, 0 if the card cannot be added
+ */
+uint64_t state_id_add(uint64_t id, int card);
+
+/**
+ * Returns the play class of the best play of a state id of 5 to 7 cards, giving the cards
+ * without a suit suits that make neither a flush nor a duplicate card.
+ * 
+ * @param id state id
+ * @return uint16_t play class
+ */
+uint16_t state_id_class(uint64_t id);
+
+/**
+ * Builds a state table from the 5 card rules and writes it to a file.
+ * 
+ * @param path path of the file to write
+ * @return true the table was written
+ * @return false the file could not be written
+ */
+bool state_table_generate(const char *path);
+
+/**
+ * Maps a state table file, building it first if it does not exist yet or was built by an older
+ * version of the rules. Any other file is left alone.
+ * 
+ * @param path path of the table file
+ * @param table resulting table
+ * @return true the table is mapped
+ * @return false the file is not a state table of this version or the table could not be built
+ */
+bool state_table_open(const char *path, StateTable *table);
+
+/**
+ * Tells whether a state table may be built at a path, that is when nothing is there yet or when
+ * the file is a state table of an older version.
+ * 
+ * @param path path of the table file
+ * @return true the path is free or holds an outdated table
+ * @return false the path holds some other file
+ */
+bool state_table_replaceable(const char *path);
+
+/**
+ * Maps an existing state table file.
+ * 
+ * @param path path of the table file
+ * @param table resulting table
+ * @return true the table is mapped
+ * @return false the file is missing or is not a valid table file of this version
+ */
+bool state_table_map(const char *path, StateTable *table);
+
+/**
+ * Unmaps a state table opened by state_table_open.
+ * 
+ * @param table table to release
+ */
+void state_table_close(StateTable *table);
+
+/**
+ * Returns the play class of a hand of 5 to 7 cards with one table lookup per card.
+ * 
+ * @param table state table
+ * @param card_count number of cards
+ * @param cards array of card indices
+ * @return uint16_t play class, higher is stronger
+ */
+uint16_t state_table_class(const StateTable *table, size_t card_count, const uint8_t *cards);
+
+/**
+ * Entry point of the states subcommand: opens or builds a state table and checks it against
+ * hand_best_strength on random hands.
+ * 
+ * @param argc number of arguments
+ * @param argv argument strings, argv[0] being the subcommand
+ * @return int process exit status
+ */
+int states_main(int argc, char const *argv[]);
+
+#ifndef POKER_FUZZER
+int main(int argc, char const *argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "states") == 0)
+        return states_main(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "convert") == 0)
+        return convert_main(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "bench") == 0)
+        return bench_main(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "generate") == 0)
+        return generate_main(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "fuzz") == 0)
+        return fuzz_main(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "exhaustive") == 0)
+        return exhaustive_main(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "equity") == 0)
+        return equity_main(argc - 1, argv + 1);
+
+    Options options = options_parse(argc, argv);
+
+    eval_tables_init();
+
+    bool streaming = strcmp(options.input_path, "-") == 0;
+    InputMap input = {.fd = -1};
+    if (!streaming && !input_map_open(options.input_path, &input))
+    {
+        printf("Could not open %s for input.", options.input_path);
+        exit(EXIT_FAILURE);
+    }
+
+    // binary deals follow their header; a file that only looks binary cannot be read as text
+    const char *begin = input.data, *end = input.data + input.size;
+    if (!streaming && deal_file_is_binary(input.data, input.size))
+    {
+        if (!deal_file_count_matches(input.data, input.size))
+        {
+            printf("Could not read %s, its deal count does not match its size.", options.input_path);
+            exit(EXIT_FAILURE);
+        }
+
+        options.binary = true;
+        begin += sizeof(DealFileHeader);
+    }
+
+    // results always go to stdout, and to the output file unless that is stdout itself
+    int fds[] = {STDOUT_FILENO, -1};
+    size_t fd_count = 1;
+    if (strcmp(options.output_path, "-") != 0)
+    {
+        fds[fd_count++] = open(options.output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fds[1] < 0)
+        {
+            printf("Could not open %s for output.", options.output_path);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    double start = time_now();
+    uint64_t start_ticks = stats_clock();
+
+    Tally tally = streaming ? run_stream(STDIN_FILENO, &options, fds, fd_count)
+                            : run_deals(begin, end, &options, fds, fd_count);
+
+    OutputBuffer out = output_buffer_make(OUTPUT_BUF_SIZE);
+
+    if (options.summary)
+        output_summary(&out, &tally);
+
+    output_printf(&out, "Player won %llu times!\n", (unsigned long long)tally.wins);
+    output_write(&out, fds, fd_count);
+
+    if (options.stats)
+    {
+        output_stats(&out, &tally, time_now() - start, stats_clock() - start_ticks);
+        output_write(&out, fds, 1);
+    }
+
+    output_buffer_free(&out);
+    if (fd_count > 1)
+        close(fds[1]);
+    if (!streaming)
+        input_map_close(&input);
+}
+#endif
+
+Options options_parse(int argc, char const *argv[])
+{
+    Options options = {
+        .threads = threads_default(),
+        .input_path = POKER_FILE_PATH,
+    };
+
+    bool input_given = false;
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--summary") == 0)
+            options.summary = true;
+        else if (threads_option(argc, argv, &i, &options.threads))
+            continue;
+        else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc)
+            options.output_path = argv[++i];
+        else if (strcmp(argv[i], "--stats") == 0)
+            options.stats = true;
+        else if ((argv[i][0] != '-' || strcmp(argv[i], "-") == 0) && !input_given)
+        {
+            options.input_path = argv[i];
+            input_given = true;
+        }
+        else
+        {
+            printf("Usage: %s [-s | --summary] [-j | --threads N] [-o | --output FILE] [--stats] [INPUT]\n"
+                   "  INPUT            file of deals, - to stream them from stdin (default: %s)\n"
+                   "  -s, --summary    only print the win, loss and draw counts and the play histogram\n"
+                   "  -j, --threads N  evaluate on N threads (default: one per online CPU)\n"
+                   "  -o, --output F   also write the results to F, - for stdout only\n"
+                   "                   (default: %s, or stdout only when streaming)\n"
+                   "  --stats          print the time spent in each stage (make stats builds) and the\n"
+                   "                   play score distribution to stdout at exit\n",
+                   argv[0], POKER_FILE_PATH, OUTPUT_FILE_PATH);
+            exit(EXIT_FAILURE);
+        }
+
+    if (!options.output_path)
+        options.output_path = strcmp(options.input_path, "-") == 0 ? "-" : OUTPUT_FILE_PATH;
+
+    return options;
+}
+
+long threads_default(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cpus < 1 ? 1 : cpus;
+}
+
+bool threads_option(int argc, char const *argv[], int *i, long *threads)
+{
+    if ((strcmp(argv[*i], "-j") != 0 && strcmp(argv[*i], "--threads") != 0) || *i + 1 >= argc)
+        return false;
+
+    long count = strtol(argv[*i + 1], NULL, 10);
+    if (count < 1)
+        return false;
+
+    *threads = count;
+    (*i)++;
+
+    return true;
+}
+
+void tally_add(Tally *tally, Strength player, Strength other)
+{
+    tally->wins += player > other;
+    tally->losses += player < other;
+    tally->draws += player == other;
+    tally->score_counts[strength_to_score(player)]++;
+    tally->score_counts[strength_to_score(other)]++;
+}
+
+void tally_merge(Tally *tally, const Tally *other)
+{
+    tally->wins += other->wins;
+    tally->losses += other->losses;
+    tally->draws += other->draws;
+    for (int score = 0; score < SCORE_COUNT; score++)
+        tally->score_counts[score] += other->score_counts[score];
+
+#ifdef POKER_STATS
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        tally->stats.ticks[stage] += other->stats.ticks[stage];
+        tally->stats.passes[stage] += other->stats.passes[stage];
+    }
+#endif
+}
+
+const char *chunk_boundary(const char *pos, const char *end, bool binary)
+{
+    if (end - pos <= CHUNK_SIZE)
+        return end;
+
+    // CHUNK_SIZE is a whole number of binary deals
+    if (binary)
+        return pos + CHUNK_SIZE;
+
+    const char *line_end = memchr(pos + CHUNK_SIZE, '\n', end - pos - CHUNK_SIZE);
+
+    return line_end ? line_end + 1 : end;
+}
+
+void process_chunk(Chunk *chunk, const Options *options)
+{
+    chunk->out.len = 0;
+    chunk->tally = (Tally){0};
+
+    STATS_START(clock);
+
+    const char *pos = chunk->begin;
+    while (pos < chunk->end)
+    {
+        uint8_t line_cards[DEAL_CARD_COUNT];
+
+        size_t card_count = options->binary ? deal_unpack(&pos, line_cards) : parse_deal(&pos, chunk->end, line_cards);
+        STATS_LAP(&chunk->tally.stats, STAGE_PARSE, clock);
+        if (card_count != DEAL_CARD_COUNT)
+            continue;
+
+        // a deal holding the same card twice is as invalid as one with an unknown card
+        if (__builtin_popcountll(hand_make(DEAL_CARD_COUNT, line_cards)) != DEAL_CARD_COUNT)
+            continue;
+
+        if (options->summary)
+        {
+            Strength player = calculate_strength(5, &line_cards[0]), other = calculate_strength(5, &line_cards[5]);
+            STATS_LAP(&chunk->tally.stats, STAGE_EVALUATE, clock);
+
+            tally_add(&chunk->tally, player, other);
+            STATS_LAP(&chunk->tally.stats, STAGE_COMPARE, clock);
+            continue;
+        }
+
+        Play player_play = calculate_play(5, &line_cards[0]);
+        Play other_play = calculate_play(5, &line_cards[5]);
+        STATS_LAP(&chunk->tally.stats, STAGE_EVALUATE, clock);
+
+        bool player_won = play_cmp(&player_play, &other_play) > 0;
+        tally_add(&chunk->tally, player_play.strength, other_play.strength);
+        STATS_LAP(&chunk->tally.stats, STAGE_COMPARE, clock);
+
+        output_reserve(&chunk->out, DEAL_TEXT_MAX);
+        output_play(&chunk->out, "(Player) ", &line_cards[0], &player_play);
+        output_play(&chunk->out, "(Other)  ", &line_cards[5], &other_play);
+        output_str(&chunk->out, player_won ? "Player won!\n\n" : "Other won!\n\n");
+        STATS_LAP(&chunk->tally.stats, STAGE_FORMAT, clock);
+    }
+}
+
+void *chunk_worker(void *arg)
+{
+    ChunkQueue *queue = arg;
+
+    pthread_mutex_lock(&queue->lock);
+    while (true)
+    {
+        // the slot of the next chunk must have been written out before it is reused
+        while ((queue->pos < queue->end && queue->carved == queue->written + queue->slot_count) ||
+               (queue->pos >= queue->end && queue->more_input))
+            pthread_cond_wait(&queue->changed, &queue->lock);
+
+        if (queue->pos >= queue->end)
+            break;
+
+        Chunk *chunk = &queue->chunks[queue->carved++ % queue->slot_count];
+        chunk->begin = queue->pos;
+        chunk->end = queue->pos = chunk_boundary(queue->pos, queue->end, queue->options->binary);
+        chunk->done = false;
+        pthread_mutex_unlock(&queue->lock);
+
+        process_chunk(chunk, queue->options);
+
+        pthread_mutex_lock(&queue->lock);
+        chunk->done = true;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return NULL;
+}
+
+Tally run_deals(const char *begin, const char *end, const Options *options, const int *fds, size_t fd_count)
+{
+    Tally tally = {0};
+
+    if (options->threads == 1)
+    {
+        Chunk chunk = {.out = output_buffer_make(OUTPUT_BUF_SIZE)};
+
+        for (const char *pos = begin; pos < end; pos = chunk.end)
+        {
+            chunk.begin = pos;
+            chunk.end = chunk_boundary(pos, end, options->binary);
+            process_chunk(&chunk, options);
+
+            STATS_START(clock);
+            output_write(&chunk.out, fds, fd_count);
+            STATS_LAP(&tally.stats, STAGE_WRITE, clock);
+            tally_merge(&tally, &chunk.tally);
+        }
+
+        output_buffer_free(&chunk.out);
+        return tally;
+    }
+
+    ChunkQueue queue = {
+        .options = options,
+        .pos = begin,
+        .end = end,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .changed = PTHREAD_COND_INITIALIZER,
+    };
+
+    return run_queue(&queue, fds, fd_count);
+}
+
+Tally run_queue(ChunkQueue *queue, const int *fds, size_t fd_count)
+{
+    Tally tally = {0};
+    long threads = queue->options->threads;
+
+    queue->slot_count = 2 * threads;
+    queue->chunks = calloc(queue->slot_count, sizeof(Chunk));
+    for (size_t i = 0; i < queue->slot_count; i++)
+        queue->chunks[i].out = output_buffer_make(OUTPUT_BUF_SIZE);
+
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    for (long i = 0; i < threads; i++)
+        pthread_create(&workers[i], NULL, chunk_worker, queue);
+
+    // write the chunks out in input order as they complete
+    pthread_mutex_lock(&queue->lock);
+    for (size_t next = 0;; next++)
+    {
+        Chunk *chunk = &queue->chunks[next % queue->slot_count];
+        while (!(next < queue->carved && chunk->done) &&
+               !(queue->pos >= queue->end && !queue->more_input && next == queue->carved))
+            pthread_cond_wait(&queue->changed, &queue->lock);
+
+        if (next == queue->carved)
+            break;
+        pthread_mutex_unlock(&queue->lock);
+
+        STATS_START(clock);
+        output_write(&chunk->out, fds, fd_count);
+        STATS_LAP(&tally.stats, STAGE_WRITE, clock);
+        tally_merge(&tally, &chunk->tally);
+
+        pthread_mutex_lock(&queue->lock);
+        queue->written++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    for (long i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+
+    for (size_t i = 0; i < queue->slot_count; i++)
+        output_buffer_free(&queue->chunks[i].out);
+    free(queue->chunks);
+    free(workers);
+
+    return tally;
+}
+
+Tally run_stream(int fd, const Options *options, const int *fds, size_t fd_count)
+{
+    Options stream_options = *options;
+    ChunkQueue queue = {
+        .options = &stream_options,
+        .more_input = true,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .changed = PTHREAD_COND_INITIALIZER,
+    };
+    StreamReader reader = {
+        .fd = fd,
+        .queue = &queue,
+        .options = &stream_options,
+        .bufs = {malloc(STREAM_BUF_SIZE), malloc(STREAM_BUF_SIZE)},
+    };
+
+    // one pool of workers serves every block, fed by the reader thread
+    pthread_t reader_thread;
+    pthread_create(&reader_thread, NULL, stream_reader, &reader);
+    Tally tally = run_queue(&queue, fds, fd_count);
+    pthread_join(reader_thread, NULL);
+    tally_merge(&tally, &reader.tally);
+
+    free(reader.bufs[0]);
+    free(reader.bufs[1]);
+
+    return tally;
+}
+
+void *stream_reader(void *arg)
+{
+    StreamReader *reader = arg;
+    ChunkQueue *queue = reader->queue;
+    size_t released[2] = {0, 0}, carry = 0, deal_count = 0;
+    const char *carry_from = NULL;
+    bool eof = false, first = true;
+    DealFileHeader header = {0};
+
+    for (int b = 0; !eof; b ^= 1)
+    {
+        char *buf = reader->bufs[b];
+
+        // a buffer is free again once every chunk carved from its last block has been written out
+        pthread_mutex_lock(&queue->lock);
+        while (queue->written < released[b])
+            pthread_cond_wait(&queue->changed, &queue->lock);
+        pthread_mutex_unlock(&queue->lock);
+
+        // start with the partial last line or deal of the block before
+        if (carry)
+            memcpy(buf, carry_from, carry);
+        size_t len = carry;
+
+        // fill the whole buffer, as a pipe hands over at most a few pages per read
+        STATS_START(clock);
+        while (len < STREAM_BUF_SIZE)
+        {
+            ssize_t n = read(reader->fd, buf + len, STREAM_BUF_SIZE - len);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                eof = true;
+                break;
+            }
+            len += n;
+        }
+        STATS_LAP(&reader->tally.stats, STAGE_READ, clock);
+
+        size_t skip = 0;
+        bool binary = reader->options->binary;
+        if (first && deal_file_is_binary(buf, len))
+        {
+            binary = true;
+            memcpy(&header, buf, sizeof(header));
+            skip = sizeof(DealFileHeader);
+        }
+        first = false;
+
+        // hand over the whole lines or deals and carry the partial last one over to the next block
+        size_t whole = len;
+        if (binary)
+        {
+            whole -= (len - skip) % sizeof(uint64_t);
+            deal_count += (whole - skip) / sizeof(uint64_t);
+        }
+        else
+        {
+            while (!eof && whole > 0 && buf[whole - 1] != '\n')
+                whole--;
+            if (whole == 0)
+                whole = len;
+        }
+
+        // the block before must be carved completely before its buffer can be released
+        pthread_mutex_lock(&queue->lock);
+        while (queue->pos < queue->end)
+            pthread_cond_wait(&queue->changed, &queue->lock);
+
+        released[b ^ 1] = queue->carved;
+        reader->options->binary = binary;
+        queue->pos = buf + skip;
+        queue->end = buf + whole;
+        queue->more_input = !eof;
+        pthread_cond_broadcast(&queue->changed);
+        pthread_mutex_unlock(&queue->lock);
+
+        carry_from = buf + whole;
+        carry = len - whole;
+    }
+
+    // like a mapped file, the stream must hold exactly the deals its header announces
+    if (reader->options->binary && (carry != 0 || deal_count != header.deal_count))
+    {
+        printf("Could not read standard input, its deal count does not match its size.");
+        exit(EXIT_FAILURE);
+    }
+
+    return NULL;
+}
+
+uint64_t stats_clock(void)
+{
+#ifdef STATS_RDTSC
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+#endif
+}
+
+void output_stats(OutputBuffer *out, Tally *tally, double seconds, uint64_t ticks)
+{
+    uint64_t deals = tally->wins + tally->losses + tally->draws;
+    output_printf(out, "Stats: %llu deals in %.3f s, %.1f ns/deal\n", (unsigned long long)deals, seconds,
+                  deals ? seconds * 1e9 / deals : 0);
+
+#ifdef POKER_STATS
+    // stage times add up over every thread, so they can exceed the wall clock time
+    const char *stage_names[STAGE_COUNT] = {"read", "parse", "evaluate", "compare", "format", "write"};
+    double ns_per_tick = ticks ? seconds * 1e9 / ticks : 0;
+
+    output_printf(out, "%-10s %12s %12s %10s\n", "Stage", "Passes", "Total ms", "ns/deal");
+    for (int stage = 0; stage < STAGE_COUNT; stage++)
+    {
+        // mapped input is read by the page faults of the parse stage and summaries format
+        // nothing, so those runs never pass through the read or the format stage
+        if (tally->stats.passes[stage] == 0)
+            continue;
+
+        double ns = tally->stats.ticks[stage] * ns_per_tick;
+        output_printf(out, "%-10s %12llu %12.3f %10.2f\n", stage_names[stage],
+                      (unsigned long long)tally->stats.passes[stage], ns / 1e6, deals ? ns / deals : 0);
+    }
+#else
+    (void)ticks;
+    output_str(out, "Stage timings need a build with -DPOKER_STATS, as made by make stats.\n");
+#endif
+
+    uint64_t hands = 2 * deals;
+    for (int score = 0; score < SCORE_COUNT; score++)
+        output_printf(out, "%-16s %10llu %7.3f%%\n", score_to_play_string(score),
+                      (unsigned long long)tally->score_counts[score],
+                      hands ? 100.0 * tally->score_counts[score] / hands : 0);
+}
+
+void output_summary(OutputBuffer *out, Tally *tally)
+{
+    output_printf(out, "Wins = %llu, Losses = %llu, Draws = %llu\n", (unsigned long long)tally->wins,
+                  (unsigned long long)tally->losses, (unsigned long long)tally->draws);
+
+    for (int score = 0; score < SCORE_COUNT; score++)
+        output_printf(out, "%s = %llu\n", score_to_play_string(score), (unsigned long long)tally->score_counts[score]);
+}
+
+OutputBuffer output_buffer_make(size_t capacity)
+{
+    return (OutputBuffer){
+        .data = malloc(capacity),
+        .capacity = capacity,
+    };
+}
+
+void output_buffer_free(OutputBuffer *out)
+{
+    free(out->data);
+    *out = (OutputBuffer){0};
+}
+
+void output_reserve(OutputBuffer *out, size_t len)
+{
+    if (out->capacity - out->len >= len)
+        return;
+
+    while (out->capacity - out->len < len)
+        out->capacity *= 2;
+    out->data = realloc(out->data, out->capacity);
+}
+
+void output_str(OutputBuffer *out, const char *str)
+{
+    size_t len = strlen(str);
+
+    memcpy(out->data + out->len, str, len);
+    out->len += len;
+}
+
+void output_printf(OutputBuffer *out, const char *formatted_message, ...)
+{
+    va_list arglist, measure_arglist;
+
+    // measure the text first so that it always fits, terminating null included
+    va_start(arglist, formatted_message);
+    va_copy(measure_arglist, arglist);
+    int len = vsnprintf(NULL, 0, formatted_message, measure_arglist);
+    va_end(measure_arglist);
+
+    if (len > 0)
+    {
+        output_reserve(out, len + 1);
+        vsnprintf(out->data + out->len, len + 1, formatted_message, arglist);
+        out->len += len;
+    }
+    va_end(arglist);
+}
+
+void output_play(OutputBuffer *out, const char *label, const uint8_t *cards, Play *play)
+{
+    output_str(out, label);
+
+    char *p = out->data + out->len;
+    for (size_t i = 0; i < 5; i++)
+    {
+        *p++ = value_to_rank(card_value(cards[i]));
+        *p++ = ' ';
+    }
+    p--;
+    out->len = p - out->data;
+
+    output_str(out, ", Play = ");
+    output_str(out, score_to_play_string(play->score));
+
+    p = out->data + out->len;
+    if (play->play_val_count)
+    {
+        memcpy(p, ", Play cards = ", 15);
+        p += 15;
+        for (size_t i = 0; i < play->play_val_count; i++)
+        {
+            *p++ = value_to_rank(play->play_vals[i]);
+            *p++ = ' ';
+        }
+        p--;
+    }
+
+    if (play->high_val_count)
+    {
+        memcpy(p, ", High cards = ", 15);
+        p += 15;
+        for (size_t i = 0; i < play->high_val_count; i++)
+        {
+            *p++ = value_to_rank(play->high_vals[i]);
+            *p++ = ' ';
+        }
+    }
+
+    *p++ = '\n';
+    out->len = p - out->data;
+}
+
+void output_write(OutputBuffer *out, const int *fds, size_t fd_count)
+{
+    for (size_t i = 0; i < fd_count; i++)
+        for (size_t written = 0; written < out->len;)
+        {
+            ssize_t n = write(fds[i], out->data + written, out->len - written);
+            if (n < 0)
+            {
+                printf("Could not write output.");
+                exit(EXIT_FAILURE);
+            }
+
+            written += n;
+        }
+
+    out->len = 0;
+}
+
+bool input_map_open(const char *path, InputMap *input)
+{
+    *input = (InputMap){.fd = open(path, O_RDONLY)};
+    if (input->fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(input->fd, &st) < 0)
+    {
+        close(input->fd);
+        return false;
+    }
+
+    input->size = st.st_size;
+    if (input->size == 0)
+        return true;
+
+    void *data = mmap(NULL, input->size, PROT_READ, MAP_PRIVATE, input->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(input->fd);
+        return false;
+    }
+
+    madvise(data, input->size, MADV_SEQUENTIAL);
+    input->data = data;
+
+    return true;
+}
+
+void input_map_close(InputMap *input)
+{
+    if (input->data)
+        munmap((void *)input->data, input->size);
+    close(input->fd);
+}
+
+size_t parse_deal(const char **pos, const char *end, uint8_t *cards)
+{
+    const char *p = *pos;
+
+#ifdef PARSE_SIMD
+    if (end - p >= 32 && __builtin_cpu_supports("sse4.1") && parse_deal_sse41(p, cards))
+    {
+        *pos = p + DEAL_LINE_LENGTH + 1;
+        return DEAL_CARD_COUNT;
+    }
+#endif
+
+    return parse_deal_scalar(pos, end, cards);
+}
+
+size_t parse_deal_scalar(const char **pos, const char *end, uint8_t *cards)
+{
+    const char *p = *pos;
+
+    // the usual fixed layout parses all ten cards without a single branch
+    if (end - p >= DEAL_LINE_LENGTH && (end - p == DEAL_LINE_LENGTH || p[DEAL_LINE_LENGTH] == '\n'))
+    {
+        uint8_t invalid = 0;
+        for (size_t i = 0; i < DEAL_CARD_COUNT; i++)
+        {
+            cards[i] = card_parse(p[3 * i], p[3 * i + 1]);
+            invalid |= cards[i];
+        }
+        for (size_t i = 0; i < DEAL_CARD_COUNT - 1; i++)
+            invalid |= (p[3 * i + 2] != ' ') * CARD_INVALID;
+
+        if (invalid < CARD_INVALID)
+        {
+            *pos = p + DEAL_LINE_LENGTH + (end - p > DEAL_LINE_LENGTH);
+            return DEAL_CARD_COUNT;
+        }
+    }
+
+    size_t card_count = 0;
+    while (card_count < DEAL_CARD_COUNT && end - p >= 2 && *p != '\n')
+    {
+        cards[card_count] = card_parse(p[0], p[1]);
+        if (cards[card_count] >= CARD_INVALID)
+            break;
+
+        card_count++;
+        p += 2;
+        if (p < end && *p == ' ')
+            p++;
+    }
+
+    const char *line_end = memchr(p, '\n', end - p);
+    *pos = line_end ? line_end + 1 : end;
+
+    return card_count;
+}
+
+#ifdef PARSE_SIMD
+__attribute__((target("sse4.1"))) bool parse_deal_sse41(const char *line, uint8_t *cards)
+{
+    // digits are looked up by their low nibble, the letters by (c ^ c >> 4) and the suits by
+    // (c ^ c >> 1); a byte is valid only if the table holds that very byte at its slot, so
+    // unused slots hold a byte whose own slot is a used one
+    const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+    const __m128i digit_chars = _mm_setr_epi8(2, 2, '2', '3', '4', '5', '6', '7', '8', '9', 2, 2, 2, 2, 2, 2);
+    const __m128i digit_values = _mm_setr_epi8(0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 0, 0, 0, 0, 0, 0);
+    const __m128i letter_chars = _mm_setr_epi8(1, 'T', 1, 1, 'Q', 'A', 1, 1, 1, 1, 1, 1, 1, 1, 'J', 'K');
+    const __m128i letter_values = _mm_setr_epi8(0, 8, 0, 0, 10, 12, 0, 0, 0, 0, 0, 0, 0, 0, 9, 11);
+    const __m128i suit_chars = _mm_setr_epi8(3, 3, 'C', 3, 3, 3, 'D', 3, 3, 3, 'S', 3, 'H', 3, 3, 3);
+    const __m128i suit_offsets = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 13, 0, 0, 0, 39, 0, 26, 0, 0, 0);
+
+    __m128i bytes[2] = {_mm_loadu_si128((const __m128i *)line), _mm_loadu_si128((const __m128i *)(line + 16))};
+    __m128i ranks[2], rank_ok[2], suits[2], suit_ok[2];
+    for (int i = 0; i < 2; i++)
+    {
+        __m128i digit_idx = _mm_and_si128(bytes[i], nibble_mask);
+        __m128i letter_idx = _mm_and_si128(_mm_xor_si128(bytes[i], _mm_srli_epi16(bytes[i], 4)), nibble_mask);
+        __m128i suit_idx = _mm_and_si128(_mm_xor_si128(bytes[i], _mm_srli_epi16(bytes[i], 1)), nibble_mask);
+
+        __m128i digit_ok = _mm_cmpeq_epi8(_mm_shuffle_epi8(digit_chars, digit_idx), bytes[i]);
+        __m128i letter_ok = _mm_cmpeq_epi8(_mm_shuffle_epi8(letter_chars, letter_idx), bytes[i]);
+
+        ranks[i] = _mm_or_si128(_mm_and_si128(_mm_shuffle_epi8(digit_values, digit_idx), digit_ok),
+                                _mm_and_si128(_mm_shuffle_epi8(letter_values, letter_idx), letter_ok));
+        rank_ok[i] = _mm_or_si128(digit_ok, letter_ok);
+        suits[i] = _mm_shuffle_epi8(suit_offsets, suit_idx);
+        suit_ok[i] = _mm_cmpeq_epi8(_mm_shuffle_epi8(suit_chars, suit_idx), bytes[i]);
+    }
+
+    // card n has its rank at byte 3n, its suit at 3n + 1 and a separator at 3n + 2
+    const __m128i rank_lo = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i rank_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, -1, -1, -1, -1, -1, -1);
+    const __m128i suit_lo = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i suit_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, -1, -1, -1, -1, -1, -1);
+    const __m128i sep_lo = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i sep_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i line_seps = _mm_setr_epi8(' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', '\n', ' ', ' ');
+
+    __m128i ok = _mm_and_si128(
+        _mm_or_si128(_mm_shuffle_epi8(rank_ok[0], rank_lo), _mm_shuffle_epi8(rank_ok[1], rank_hi)),
+        _mm_or_si128(_mm_shuffle_epi8(suit_ok[0], suit_lo), _mm_shuffle_epi8(suit_ok[1], suit_hi)));
+    ok = _mm_and_si128(ok, _mm_or_si128(_mm_shuffle_epi8(_mm_cmpeq_epi8(bytes[0], _mm_set1_epi8(' ')), sep_lo),
+                                        _mm_shuffle_epi8(_mm_cmpeq_epi8(bytes[1], line_seps), sep_hi)));
+    if ((_mm_movemask_epi8(ok) & 0x3FF) != 0x3FF)
+        return false;
+
+    uint8_t parsed[16];
+    _mm_storeu_si128((__m128i *)parsed,
+                     _mm_add_epi8(_mm_or_si128(_mm_shuffle_epi8(ranks[0], rank_lo), _mm_shuffle_epi8(ranks[1], rank_hi)),
+                                  _mm_or_si128(_mm_shuffle_epi8(suits[0], suit_lo), _mm_shuffle_epi8(suits[1], suit_hi))));
+    memcpy(cards, parsed, DEAL_CARD_COUNT);
+
+    return true;
+}
+#endif
+
+int rank_to_value(char rank)
+{
+    switch (rank)
+    {
+    case '2':
+        return 0;
+    case '3':
+        return 1;
+    case '4':
+        return 2;
+    case '5':
+        return 3;
+    case '6':
+        return 4;
+    case '7':
+        return 5;
+    case '8':
+        return 6;
+    case '9':
+        return 7;
+    case 'T':
+        return 8;
+    case 'J':
+        return 9;
+    case 'Q':
+        return 10;
+    case 'K':
+        return 11;
+    case 'A':
+        return 12;
+    default:
+        return -1;
+    }
+}
+
+char value_to_rank(int value)
+{
+    switch (value)
+    {
+    case 0:
+        return '2';
+    case 1:
+        return '3';
+    case 2:
+        return '4';
+    case 3:
+        return '5';
+    case 4:
+        return '6';
+    case 5:
+        return '7';
+    case 6:
+        return '8';
+    case 7:
+        return '9';
+    case 8:
+        return 'T';
+    case 9:
+        return 'J';
+    case 10:
+        return 'Q';
+    case 11:
+        return 'K';
+    case 12:
+        return 'A';
+    default:
+        return '\0';
+    }
+}
+
+int count_to_n_pairs(int count)
+{
+    switch (count)
+    {
+    case 0:
+        return 0;
+    case 1:
+        return 0;
+    case 2:
+        return 1;
+    case 3:
+        return 3;
+    case 4:
+        return 6;
+    default:
+        return -1;
+    }
+}
+
+int n_pairs_to_score(int n_pairs)
+{
+    switch (n_pairs)
+    {
+    case 0:
+        return 0;
+    case 1:
+        return 1;
+    case 2:
+        return 2;
+    case 3:
+        return 3;
+    case 4:
+        return 6;
+    case 6:
+        return 7;
+    default:
+        return -1;
+    }
+}
+
+char *score_to_play_string(int score)
+{
+    switch (score)
+    {
+    case 0:
+        return "High Card";
+    case 1:
+        return "Pair";
+    case 2:
+        return "Two Pair";
+    case 3:
+        return "Three of a Kind";
+    case 4:
+        return "Straight";
+    case 5:
+        return "Flush";
+    case 6:
+        return "Full House";
+    case 7:
+        return "Four of a Kind";
+    case 8:
+        return "Straight Flush";
+    case 9:
+        return "Royal Flush";
+    default:
+        return NULL;
+    }
+}
+
+size_t score_to_play_val_count(int score)
+{
+    switch (score)
+    {
+    case 1:
+        return 2;
+    case 2:
+        return 4;
+    case 3:
+        return 3;
+    case 4:
+        return 5;
+    case 5:
+        return 5;
+    case 6:
+        return 5;
+    case 7:
+        return 4;
+    case 8:
+        return 5;
+    default:
+        return 0;
+    }
+}
+
+size_t score_to_high_val_count(int score)
+{
+    switch (score)
+    {
+    case 0:
+        return 5;
+    case 1:
+        return 3;
+    case 2:
+        return 1;
+    case 3:
+        return 2;
+    case 7:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+uint8_t card_parse(char rank, char suit)
+{
+    return RANK_VALUES[(uint8_t)rank] + SUIT_OFFSETS[(uint8_t)suit];
+}
+
+int card_value(uint8_t card)
+{
+    return card % SUIT_RANK_BITS;
+}
+
+Hand hand_make(size_t card_count, const uint8_t *cards)
+{
+    Hand hand = 0;
+
+    for (size_t i = 0; i < card_count; i++)
+        hand |= (Hand)1 << cards[i];
+
+    return hand;
+}
+
+uint16_t hand_suit_ranks(Hand hand, int suit)
+{
+    return (hand >> (suit * SUIT_RANK_BITS)) & SUIT_RANK_MASK;
+}
+
+RankCounts hand_get_rank_counts(Hand hand)
+{
+    uint16_t c = hand_suit_ranks(hand, 0), d = hand_suit_ranks(hand, 1);
+    uint16_t h = hand_suit_ranks(hand, 2), s = hand_suit_ranks(hand, 3);
+
+    // bit-sliced population count across the four suit masks
+    uint16_t at_least_one = c | d | h | s;
+    uint16_t at_least_two = (c & d) | (h & s) | ((c | d) & (h | s));
+    uint16_t at_least_three = (c & d & (h | s)) | (h & s & (c | d));
+    uint16_t four = c & d & h & s;
+
+    return (RankCounts){
+        .ones = at_least_one & ~at_least_two,
+        .twos = at_least_two & ~at_least_three,
+        .threes = at_least_three & ~four,
+        .fours = four,
+    };
+}
+
+Strength calc_pairs(Hand hand)
+{
+    RankCounts counts = hand_get_rank_counts(hand);
+
+    int n_pairs = count_to_n_pairs(2) * __builtin_popcount(counts.twos) +
+                  count_to_n_pairs(3) * __builtin_popcount(counts.threes) +
+                  count_to_n_pairs(4) * __builtin_popcount(counts.fours);
+
+    // values of the biggest groups go first, highest value first within a group
+    uint16_t groups[] = {counts.fours, counts.threes, counts.twos, counts.ones};
+
+    Strength vals = 0;
+    int val_count = 0;
+    for (int count = 4; count > 0; count--)
+        for (int i = SUIT_RANK_BITS - 1; i >= 0; i--)
+            if (groups[4 - count] >> i & 1)
+                for (int j = 0; j < count && val_count < 5; j++, val_count++)
+                    vals = vals << STRENGTH_VAL_BITS | i;
+
+    vals <<= STRENGTH_VAL_BITS * (5 - val_count);
+
+    return (Strength)n_pairs_to_score(n_pairs) << STRENGTH_SCORE_SHIFT | vals;
+}
+
+bool is_straight(Hand hand)
+{
+    uint16_t ranks = hand_suit_ranks(hand, 0) | hand_suit_ranks(hand, 1) |
+                     hand_suit_ranks(hand, 2) | hand_suit_ranks(hand, 3);
+
+    // five cards only make a run of five with five distinct ranks
+    return straight_tops(ranks) != 0;
+}
+
+bool is_flush(Hand hand)
+{
+    // the lowest card fixes the suit, so every card must lie in that suit's 13 bits
+    return hand && (hand >> (__builtin_ctzll(hand) / SUIT_RANK_BITS * SUIT_RANK_BITS)) <= SUIT_RANK_MASK;
+}
+
+bool is_royal(Hand hand)
+{
+    uint16_t royal_ranks = 0;
+    for (char *rank = "TJQKA"; *rank; rank++)
+        royal_ranks |= 1 << rank_to_value(*rank);
+
+    return is_flush(hand) &&
+           hand >> (__builtin_ctzll(hand) / SUIT_RANK_BITS * SUIT_RANK_BITS) == royal_ranks;
+}
+
+int strength_ascending_cmp(const void *a, const void *b)
+{
+    Strength lhs = *(const Strength *)a, rhs = *(const Strength *)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+uint16_t strength_to_class(Strength strength)
+{
+    Strength *found = bsearch(&strength, &class_strengths[1], PLAY_CLASS_COUNT, sizeof(Strength),
+                              strength_ascending_cmp);
+
+    return found - class_strengths;
+}
+
+void eval_tables_init(void)
+{
+    for (int i = 0; i < CARD_COUNT; i++)
+    {
+        int suit = i / SUIT_RANK_BITS, value = i % SUIT_RANK_BITS;
+        card_words[i] = 1u << (16 + value) | 1u << (12 + suit) | value << 8 | RANK_PRIMES[value];
+    }
+
+    // every multiset of five values, plus a flush variant for the ones without pairs
+    typedef struct
+    {
+        uint16_t ranks;
+        uint32_t prime_product;
+        bool paired;
+        Strength strength;
+        Strength flush_strength;
+    } RankSet;
+
+    RankSet rank_sets[PLAY_CLASS_COUNT];
+    size_t rank_set_count = 0, class_count = 0;
+
+    int v[5];
+    for (v[0] = 0; v[0] < SUIT_RANK_BITS; v[0]++)
+        for (v[1] = v[0]; v[1] < SUIT_RANK_BITS; v[1]++)
+            for (v[2] = v[1]; v[2] < SUIT_RANK_BITS; v[2]++)
+                for (v[3] = v[2]; v[3] < SUIT_RANK_BITS; v[3]++)
+                    for (v[4] = v[3]; v[4] < SUIT_RANK_BITS; v[4]++)
+                    {
+                        if (v[0] == v[4])
+                            continue;
+
+                        RankSet set = {.prime_product = 1};
+                        Hand hand = 0, flush_hand = 0;
+                        for (int i = 0, repeat = 0; i < 5; i++)
+                        {
+                            repeat = i && v[i] == v[i - 1] ? repeat + 1 : 0;
+                            set.ranks |= 1 << v[i];
+                            set.prime_product *= RANK_PRIMES[v[i]];
+                            flush_hand |= (Hand)1 << v[i];
+                            hand |= (Hand)1 << (repeat * SUIT_RANK_BITS + v[i]);
+                        }
+
+                        // distinct values are spread over the suits so they cannot flush
+                        set.paired = __builtin_popcount(set.ranks) < 5;
+                        if (!set.paired)
+                        {
+                            hand = 0;
+                            for (int i = 0; i < 5; i++)
+                                hand |= (Hand)1 << (i % SUIT_COUNT * SUIT_RANK_BITS + v[i]);
+
+                            set.flush_strength = hand_strength(flush_hand);
+                            class_strengths[++class_count] = set.flush_strength;
+                        }
+
+                        set.strength = hand_strength(hand);
+                        class_strengths[++class_count] = set.strength;
+                        rank_sets[rank_set_count++] = set;
+                    }
+
+    qsort(&class_strengths[1], class_count, sizeof(Strength), strength_ascending_cmp);
+
+    // hash and displace: fill the biggest buckets first, each at the first free xor offset,
+    // and retry with another multiplier in the rare case that a bucket cannot be placed
+    uint16_t bucket_sizes[1 << PAIRED_BUCKET_BITS];
+    uint32_t bucket_keys[1 << PAIRED_BUCKET_BITS][8];
+    bool slot_used[1 << PAIRED_SLOT_BITS];
+    for (paired_hash_mul = 0x9E3779B97F4A7C15;; paired_hash_mul += 0x2545F4914F6CDD1E)
+    {
+        bool placed = true;
+        memset(bucket_sizes, 0, sizeof(bucket_sizes));
+        memset(slot_used, 0, sizeof(slot_used));
+        memset(paired_displacements, 0, sizeof(paired_displacements));
+
+        for (size_t i = 0; i < rank_set_count && placed; i++)
+        {
+            if (!rank_sets[i].paired)
+                continue;
+
+            uint32_t bucket = rank_sets[i].prime_product * paired_hash_mul >> (64 - PAIRED_BUCKET_BITS);
+            if (bucket_sizes[bucket] == 8)
+                placed = false;
+            else
+                bucket_keys[bucket][bucket_sizes[bucket]++] = rank_sets[i].prime_product;
+        }
+
+        for (int size = 8; size > 0 && placed; size--)
+            for (uint32_t bucket = 0; bucket < 1 << PAIRED_BUCKET_BITS && placed; bucket++)
+            {
+                if (bucket_sizes[bucket] != size)
+                    continue;
+
+                placed = false;
+                for (uint32_t displacement = 0; displacement < 1 << PAIRED_SLOT_BITS && !placed; displacement++)
+                {
+                    paired_displacements[bucket] = displacement;
+
+                    uint32_t slots[8];
+                    placed = true;
+                    for (int i = 0; i < size && placed; i++)
+                    {
+                        slots[i] = paired_slot(bucket_keys[bucket][i]);
+                        placed = !slot_used[slots[i]];
+                        for (int j = 0; j < i; j++)
+                            placed &= slots[j] != slots[i];
+                    }
+
+                    for (int i = 0; i < size && placed; i++)
+                        slot_used[slots[i]] = true;
+                }
+            }
+
+        if (placed)
+            break;
+    }
+
+    for (size_t i = 0; i < rank_set_count; i++)
+        if (rank_sets[i].paired)
+            paired_classes[paired_slot(rank_sets[i].prime_product)] = strength_to_class(rank_sets[i].strength);
+        else
+        {
+            unique_classes[rank_sets[i].ranks] = strength_to_class(rank_sets[i].strength);
+            flush_classes[rank_sets[i].ranks] = strength_to_class(rank_sets[i].flush_strength);
+        }
+}
+
+uint32_t paired_slot(uint32_t prime_product)
+{
+    uint64_t hash = prime_product * paired_hash_mul;
+    uint32_t bucket = hash >> (64 - PAIRED_BUCKET_BITS);
+    uint32_t slot = hash >> (64 - PAIRED_BUCKET_BITS - PAIRED_SLOT_BITS) & ((1 << PAIRED_SLOT_BITS) - 1);
+
+    return slot ^ paired_displacements[bucket];
+}
+
+uint16_t eval5_class(int a, int b, int c, int d, int e)
+{
+    uint32_t wa = card_words[a], wb = card_words[b], wc = card_words[c], wd = card_words[d], we = card_words[e];
+    uint32_t ranks = (wa | wb | wc | wd | we) >> 16;
+
+    if (wa & wb & wc & wd & we & 0xF000)
+        return flush_classes[ranks];
+
+    if (unique_classes[ranks])
+        return unique_classes[ranks];
+
+    return paired_classes[paired_slot((wa & 0xFF) * (wb & 0xFF) * (wc & 0xFF) * (wd & 0xFF) * (we & 0xFF))];
+}
+
+Strength calculate_strength(size_t card_count, const uint8_t *cards)
+{
+    if (card_count != 5)
+        return hand_best_strength(hand_make(card_count, cards));
+
+    return class_strengths[eval5_class(cards[0], cards[1], cards[2], cards[3], cards[4])];
+}
+
+Play calculate_play(size_t card_count, const uint8_t *cards)
+{
+    return strength_to_play(calculate_strength(card_count, cards));
+}
+
+Strength hand_strength(Hand hand)
+{
+    Strength strength = calc_pairs(hand);
+    Strength vals = strength & (((Strength)1 << STRENGTH_SCORE_SHIFT) - 1);
+
+    // a straight or flush has no pairs, so its values are already in descending order, except
+    // for the wheel whose ace counts low
+    bool curr_is_straight = is_straight(hand);
+    bool curr_is_flush = is_flush(hand);
+    if ((curr_is_straight || curr_is_flush) && strength_to_score(strength) < 4)
+    {
+        int score = curr_is_straight && curr_is_flush ? 8 : curr_is_flush ? 5 : 4;
+        if (score == 8 && is_royal(hand))
+            score = 9;
+        if (curr_is_straight)
+        {
+            uint16_t ranks = hand_suit_ranks(hand, 0) | hand_suit_ranks(hand, 1) |
+                             hand_suit_ranks(hand, 2) | hand_suit_ranks(hand, 3);
+            vals = straight_vals(31 - __builtin_clz(straight_tops(ranks)));
+        }
+
+        strength = (Strength)score << STRENGTH_SCORE_SHIFT | vals;
+    }
+
+    return strength;
+}
+
+uint16_t straight_tops(uint16_t ranks)
+{
+    // shift every value up one place with the ace copied into the free bottom place
+    uint16_t low_ace = ranks << 1 | ranks >> (SUIT_RANK_BITS - 1);
+
+    return (low_ace & low_ace << 1 & low_ace << 2 & low_ace << 3 & low_ace << 4) >> 1;
+}
+
+Strength straight_vals(int top)
+{
+    Strength vals = 0;
+    for (int i = 0; i < 5; i++)
+        vals = vals << STRENGTH_VAL_BITS | (top - i + SUIT_RANK_BITS) % SUIT_RANK_BITS;
+
+    return vals;
+}
+
+Strength vals_push(Strength vals, int value, int count)
+{
+    for (int i = 0; i < count; i++)
+        vals = vals << STRENGTH_VAL_BITS | value;
+
+    return vals;
+}
+
+Strength vals_push_top(Strength vals, uint16_t ranks, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int value = 31 - __builtin_clz(ranks);
+        vals = vals << STRENGTH_VAL_BITS | value;
+        ranks &= ~(1u << value);
+    }
+
+    return vals;
+}
+
+Strength hand_best_strength(Hand hand)
+{
+    RankCounts counts = hand_get_rank_counts(hand);
+    uint16_t ranks = counts.ones | counts.twos | counts.threes | counts.fours;
+
+    // seven cards hold at most one suit with five or more of them
+    uint16_t flush_ranks = 0;
+    for (int suit = 0; suit < SUIT_COUNT; suit++)
+        if (__builtin_popcount(hand_suit_ranks(hand, suit)) >= 5)
+            flush_ranks = hand_suit_ranks(hand, suit);
+
+    int score, top;
+    Strength vals = 0;
+
+    if (straight_tops(flush_ranks))
+    {
+        top = 31 - __builtin_clz(straight_tops(flush_ranks));
+        score = top == SUIT_RANK_BITS - 1 ? 9 : 8;
+        vals = straight_vals(top);
+    }
+    else if (counts.fours)
+    {
+        top = 31 - __builtin_clz(counts.fours);
+        score = 7;
+        vals = vals_push_top(vals_push(0, top, 4), ranks & ~(1u << top), 1);
+    }
+    else if (counts.threes && ((counts.threes & (counts.threes - 1)) || counts.twos))
+    {
+        // a second three of a kind can only serve as the pair
+        top = 31 - __builtin_clz(counts.threes);
+        uint16_t pairs = (counts.threes & ~(1u << top)) | counts.twos;
+        score = 6;
+        vals = vals_push(vals_push(0, top, 3), 31 - __builtin_clz(pairs), 2);
+    }
+    else if (flush_ranks)
+    {
+        score = 5;
+        vals = vals_push_top(0, flush_ranks, 5);
+    }
+    else if (straight_tops(ranks))
+    {
+        top = 31 - __builtin_clz(straight_tops(ranks));
+        score = 4;
+        vals = straight_vals(top);
+    }
+    else if (counts.threes)
+    {
+        top = 31 - __builtin_clz(counts.threes);
+        score = 3;
+        vals = vals_push_top(vals_push(0, top, 3), ranks & ~(1u << top), 2);
+    }
+    else if (counts.twos & (counts.twos - 1))
+    {
+        int high = 31 - __builtin_clz(counts.twos);
+        int low = 31 - __builtin_clz(counts.twos & ~(1u << high));
+        score = 2;
+        vals = vals_push_top(vals_push(vals_push(0, high, 2), low, 2), ranks & ~(1u << high | 1u << low), 1);
+    }
+    else if (counts.twos)
+    {
+        top = 31 - __builtin_clz(counts.twos);
+        score = 1;
+        vals = vals_push_top(vals_push(0, top, 2), ranks & ~(1u << top), 3);
+    }
+    else
+    {
+        score = 0;
+        vals = vals_push_top(0, ranks, 5);
+    }
+
+    return (Strength)score << STRENGTH_SCORE_SHIFT | vals;
+}
+
+int strength_to_score(Strength strength)
+{
+    return strength >> STRENGTH_SCORE_SHIFT;
+}
+
+Play strength_to_play(Strength strength)
+{
+    int score = strength_to_score(strength);
+
+    Play play = {
+        .score = score,
+        .strength = strength,
+        .play_val_count = score_to_play_val_count(score),
+        .high_val_count = score_to_high_val_count(score),
+    };
+
+    // the play values come first and the high values after them, five values in all
+    for (size_t i = 0; i < PLAY_CARD_COUNT; i++)
+    {
+        uint8_t val = strength >> (STRENGTH_SCORE_SHIFT - (i + 1) * STRENGTH_VAL_BITS) & 0xF;
+        if (i < play.play_val_count)
+            play.play_vals[i] = val;
+        else if (i - play.play_val_count < play.high_val_count)
+            play.high_vals[i - play.play_val_count] = val;
+    }
+
+    return play;
+}
+
+Play calculate_hand_play(Hand hand)
+{
+    return strength_to_play(hand_strength(hand));
+}
+
+int play_cmp(Play *a, Play *b)
+{
+    return (a->strength > b->strength) - (a->strength < b->strength);
+}
+
+uint64_t rng_next(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+
+    return z ^ (z >> 31);
+}
+
+Hand deal_random(uint64_t *rng, size_t card_count, uint8_t *cards)
+{
+    Hand hand = 0;
+
+    for (size_t i = 0; i < card_count;)
+    {
+        uint8_t card = (rng_next(rng) >> 32) * CARD_COUNT >> 32;
+        if (hand >> card & 1)
+            continue;
+
+        hand |= (Hand)1 << card;
+        cards[i++] = card;
+    }
+
+    return hand;
+}
+
+void deck_deal_partial(uint8_t *deck, size_t deck_count, size_t n, uint64_t *rng)
+{
+    for (size_t j = 0; j < n; j += 2)
+    {
+        uint64_t r = rng_next(rng);
+        size_t a = j + ((r & 0xFFFFFFFF) * (deck_count - j) >> 32);
+        uint8_t swap = deck[j];
+        deck[j] = deck[a];
+        deck[a] = swap;
+
+        if (j + 1 == n)
+            break;
+
+        size_t b = j + 1 + ((r >> 32) * (deck_count - j - 1) >> 32);
+        swap = deck[j + 1];
+        deck[j + 1] = deck[b];
+        deck[b] = swap;
+    }
+}
+
+uint64_t thread_seed(uint64_t seed, uint64_t index)
+{
+    uint64_t state = seed ^ index * 0xD1B54A32D192ED03;
+
+    return rng_next(&state);
+}
+
+uint64_t state_id_add(uint64_t id, int card)
+{
+    int cards[8] = {0}, card_count = 0;
+    for (int i = 0; i < 7; i++)
+        if (id >> (8 * i) & 0xFF)
+            cards[card_count++] = id >> (8 * i) & 0xFF;
+
+    int new_card = (card % SUIT_RANK_BITS + 1) << 4 | (card / SUIT_RANK_BITS + 1);
+    int rank_counts[14] = {0}, suit_counts[5] = {0};
+    for (int i = 0; i < card_count; i++)
+    {
+        if (cards[i] == new_card)
+            return 0;
+
+        rank_counts[cards[i] >> 4]++;
+        suit_counts[cards[i] & 0xF]++;
+    }
+
+    if (rank_counts[new_card >> 4] == 4)
+        return 0;
+
+    cards[card_count++] = new_card;
+    suit_counts[new_card & 0xF]++;
+
+    // a flush needs five of a suit, so with n cards out of 7 a suit needs n - 2 already
+    int needed = card_count - 2;
+    if (needed > 1)
+        for (int i = 0; i < card_count; i++)
+            if (suit_counts[cards[i] & 0xF] < needed)
+                cards[i] &= 0xF0;
+
+    for (int i = 1; i < card_count; i++)
+        for (int j = i; j > 0 && cards[j] > cards[j - 1]; j--)
+        {
+            int swap = cards[j];
+            cards[j] = cards[j - 1];
+            cards[j - 1] = swap;
+        }
+
+    uint64_t new_id = 0;
+    for (int i = 0; i < card_count; i++)
+        new_id |= (uint64_t)cards[i] << (8 * i);
+
+    return new_id;
+}
+
+uint16_t state_id_class(uint64_t id)
+{
+    Hand hand = 0;
+    int suit_counts[4] = {0}, flush_suit = -1;
+
+    for (int i = 0; i < 7; i++)
+    {
+        int card = id >> (8 * i) & 0xFF;
+        if (card & 0xF)
+        {
+            flush_suit = (card & 0xF) - 1;
+            hand |= (Hand)1 << (flush_suit * SUIT_RANK_BITS + (card >> 4) - 1);
+            suit_counts[flush_suit]++;
+        }
+    }
+
+    // blanked suits go to the emptiest other suit not already holding that value
+    for (int i = 0; i < 7; i++)
+    {
+        int card = id >> (8 * i) & 0xFF;
+        if (!card || card & 0xF)
+            continue;
+
+        int best_suit = -1;
+        for (int suit = 0; suit < SUIT_COUNT; suit++)
+            if (suit != flush_suit && !(hand >> (suit * SUIT_RANK_BITS + (card >> 4) - 1) & 1) &&
+                (best_suit < 0 || suit_counts[suit] < suit_counts[best_suit]))
+                best_suit = suit;
+
+        hand |= (Hand)1 << (best_suit * SUIT_RANK_BITS + (card >> 4) - 1);
+        suit_counts[best_suit]++;
+    }
+
+    return strength_to_class(hand_best_strength(hand));
+}
+
+int state_id_cmp(const void *a, const void *b)
+{
+    uint64_t lhs = *(const uint64_t *)a, rhs = *(const uint64_t *)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+bool state_table_generate(const char *path)
+{
+    // collect the ids of every state of up to 6 cards, one card count at a time
+    size_t id_count = 1, level_begin = 0;
+    uint64_t *ids = calloc(1, sizeof(uint64_t));
+
+    for (int level = 1; level < 7; level++)
+    {
+        size_t level_end = id_count, candidate_count = 0;
+        uint64_t *candidates = malloc((level_end - level_begin) * CARD_COUNT * sizeof(uint64_t));
+
+        for (size_t i = level_begin; i < level_end; i++)
+            for (int card = 0; card < CARD_COUNT; card++)
+            {
+                uint64_t new_id = state_id_add(ids[i], card);
+                if (new_id)
+                    candidates[candidate_count++] = new_id;
+            }
+
+        qsort(candidates, candidate_count, sizeof(uint64_t), state_id_cmp);
+
+        ids = realloc(ids, (id_count + candidate_count) * sizeof(uint64_t));
+        for (size_t i = 0; i < candidate_count; i++)
+            if (i == 0 || candidates[i] != candidates[i - 1])
+                ids[id_count++] = candidates[i];
+
+        free(candidates);
+        level_begin = level_end;
+    }
+
+    // ids only grow level by level, and the ids of a level have more nonzero bytes than the
+    // ones before, so the whole list is already sorted for the binary searches below
+    size_t entry_count = (id_count + 1) * STATE_CARD_SLOTS;
+    uint32_t *states = calloc(entry_count, sizeof(uint32_t));
+
+    for (size_t i = 0; i < id_count; i++)
+    {
+        uint32_t *slots = &states[(i + 1) * STATE_CARD_SLOTS];
+        int card_count = ids[i] ? (71 - __builtin_clzll(ids[i])) / 8 : 0;
+
+        if (card_count >= 5)
+            slots[0] = state_id_class(ids[i]);
+
+        for (int card = 0; card < CARD_COUNT; card++)
+        {
+            uint64_t new_id = state_id_add(ids[i], card);
+            if (!new_id)
+                continue;
+
+            if (card_count == 6)
+                slots[card + 1] = state_id_class(new_id);
+            else
+            {
+                uint64_t *found = bsearch(&new_id, ids, id_count, sizeof(uint64_t), state_id_cmp);
+                slots[card + 1] = (found - ids + 1) * STATE_CARD_SLOTS;
+            }
+        }
+    }
+
+    free(ids);
+
+    StateTableHeader header = {
+        .magic = "PKRSTATE",
+        .version = STATE_TABLE_VERSION,
+        .entry_count = entry_count,
+    };
+
+    // write beside the table and rename, so that a table being mapped is never half written
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE *fp = fopen(temp_path, "wb");
+    bool written = fp && fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                   fwrite(states, sizeof(uint32_t), entry_count, fp) == entry_count;
+    if (fp && fclose(fp) != 0)
+        written = false;
+    written = written && rename(temp_path, path) == 0;
+
+    free(states);
+
+    return written;
+}
+
+bool state_table_open(const char *path, StateTable *table)
+{
+    if (state_table_map(path, table))
+        return true;
+
+    if (!state_table_replaceable(path))
+    {
+        printf("Could not use %s, it is not a state table of this version.\n", path);
+        return false;
+    }
+
+    return state_table_generate(path) && state_table_map(path, table);
+}
 
-    int val_idx = 0;
+bool state_table_replaceable(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return errno == ENOENT;
+
+    StateTableHeader header;
+    bool outdated = read(fd, &header, sizeof(header)) == sizeof(header) &&
+                    memcmp(header.magic, "PKRSTATE", 8) == 0 && header.version < STATE_TABLE_VERSION;
+    close(fd);
+
+    return outdated;
+}
+
+bool state_table_map(const char *path, StateTable *table)
+{
+    InputMap input;
+    if (!input_map_open(path, &input))
+        return false;
+    close(input.fd);
+
+    const StateTableHeader *header = (const StateTableHeader *)input.data;
+    if (input.size < sizeof(StateTableHeader) || memcmp(header->magic, "PKRSTATE", 8) != 0 ||
+        header->version != STATE_TABLE_VERSION ||
+        input.size != sizeof(StateTableHeader) + header->entry_count * sizeof(uint32_t))
+    {
+        if (input.data)
+            munmap((void *)input.data, input.size);
+        return false;
+    }
+
+    // lookups hop all over the table, read ahead would only waste page cache
+    madvise((void *)input.data, input.size, MADV_RANDOM);
+
+    *table = (StateTable){
+        .states = (const uint32_t *)(header + 1),
+        .entry_count = header->entry_count,
+        .map = (void *)input.data,
+        .map_size = input.size,
+    };
+
+    return true;
+}
+
+void state_table_close(StateTable *table)
+{
+    munmap(table->map, table->map_size);
+    *table = (StateTable){0};
+}
+
+uint16_t state_table_class(const StateTable *table, size_t card_count, const uint8_t *cards)
+{
+    uint32_t p = STATE_CARD_SLOTS;
+
+    for (size_t i = 0; i < card_count; i++)
+        p = table->states[p + cards[i] + 1];
+
+    return card_count < 7 ? table->states[p] : p;
+}
+
+int states_main(int argc, char const *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : STATE_TABLE_PATH;
+
+    eval_tables_init();
+
+    StateTable table;
+    if (!state_table_open(path, &table))
+    {
+        printf("Could not open or build state table %s.\n", path);
+        return EXIT_FAILURE;
+    }
+
+    printf("State table %s: %zu entries, %zu MB\n", path, table.entry_count, table.map_size >> 20);
+
+    // compare against the bitmask evaluator on hands of 5, 6 and 7 cards
+    uint64_t rng = 1;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < 3000000; i++)
+    {
+        uint8_t cards[7];
+        size_t card_count = 5 + i % 3;
+        Hand hand = deal_random(&rng, card_count, cards);
+
+        mismatches += class_strengths[state_table_class(&table, card_count, cards)] != hand_best_strength(hand);
+    }
+
+    printf("Checked 3000000 random hands, %zu mismatches\n", mismatches);
+
+    // time 7 card lookups alone, with the hands dealt up front
+    size_t hand_count = 1000000;
+    uint8_t *hands = malloc(hand_count * 7);
+    for (size_t i = 0; i < hand_count; i++)
+        deal_random(&rng, 7, &hands[i * 7]);
+
+    uint32_t checksum = 0;
+    double start = time_now();
+    for (size_t i = 0; i < hand_count; i++)
+        checksum += state_table_class(&table, 7, &hands[i * 7]);
+
+    double seconds = time_now() - start;
+    printf("Evaluated %zu 7 card hands in %.3f s, %.1f ns/hand (checksum %u)\n", hand_count, seconds,
+           seconds * 1e9 / hand_count, checksum);
+
+    free(hands);
+
+    state_table_close(&table);
+
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void evaluate_batch(const uint64_t *hands, uint32_t *strengths, size_t n)
+{
+    size_t i = 0;
+
+#ifdef EVAL_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        for (; i + 8 <= n; i += 8)
+            evaluate8_avx2(&hands[i], &strengths[i]);
+#endif
+
+    for (; i < n; i++)
+        strengths[i] = hand_best_strength(hands[i]);
+}
+
+#ifdef EVAL_SIMD
+__attribute__((target("avx2"))) __m256i popcount8(__m256i x)
+{
+    const __m256i nibble_counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                   0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0F);
+
+    __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(x, low_nibbles)),
+                                     _mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(_mm256_srli_epi32(x, 4), low_nibbles)));
+
+    // the top byte of the product sums the four byte counts
+    return _mm256_srli_epi32(_mm256_mullo_epi32(counts, _mm256_set1_epi32(0x01010101)), 24);
+}
+
+__attribute__((target("avx2"))) __m256i top_bit8(__m256i x)
+{
+    __m256i exponent = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(x)), 23);
+
+    return _mm256_sub_epi32(exponent, _mm256_set1_epi32(127));
+}
+
+__attribute__((target("avx2"))) __m256i straight_tops8(__m256i ranks)
+{
+    __m256i low_ace = _mm256_or_si256(_mm256_slli_epi32(ranks, 1), _mm256_srli_epi32(ranks, SUIT_RANK_BITS - 1));
+
+    __m256i tops = _mm256_and_si256(low_ace, _mm256_slli_epi32(low_ace, 1));
+    tops = _mm256_and_si256(tops, _mm256_slli_epi32(low_ace, 2));
+    tops = _mm256_and_si256(tops, _mm256_slli_epi32(low_ace, 3));
+
+    return _mm256_srli_epi32(_mm256_and_si256(tops, _mm256_slli_epi32(low_ace, 4)), 1);
+}
+
+__attribute__((target("avx2"))) void evaluate8_avx2(const uint64_t *hands, uint32_t *strengths)
+{
+    const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi32(1);
+    const __m256i suit_mask = _mm256_set1_epi32(SUIT_RANK_MASK);
+
+    // gather the low and high halves of the 8 hands into one lane per hand
+    const __m256i halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i a = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)hands), halves);
+    __m256i b = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(hands + 4)), halves);
+    __m256i low = _mm256_permute2x128_si256(a, b, 0x20), high = _mm256_permute2x128_si256(a, b, 0x31);
+
+    __m256i c = _mm256_and_si256(low, suit_mask);
+    __m256i d = _mm256_and_si256(_mm256_srli_epi32(low, SUIT_RANK_BITS), suit_mask);
+    __m256i h = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi32(low, 2 * SUIT_RANK_BITS),
+                                                 _mm256_slli_epi32(high, 32 - 2 * SUIT_RANK_BITS)), suit_mask);
+    __m256i s = _mm256_and_si256(_mm256_srli_epi32(high, 3 * SUIT_RANK_BITS - 32), suit_mask);
+
+    // rank count histogram, bit-sliced as in hand_get_rank_counts
+    __m256i cd_or = _mm256_or_si256(c, d), hs_or = _mm256_or_si256(h, s);
+    __m256i cd_and = _mm256_and_si256(c, d), hs_and = _mm256_and_si256(h, s);
+    __m256i ranks = _mm256_or_si256(cd_or, hs_or);
+    __m256i at_least_two = _mm256_or_si256(_mm256_or_si256(cd_and, hs_and), _mm256_and_si256(cd_or, hs_or));
+    __m256i at_least_three = _mm256_or_si256(_mm256_and_si256(cd_and, hs_or), _mm256_and_si256(hs_and, cd_or));
+    __m256i fours = _mm256_and_si256(cd_and, hs_and);
+    __m256i threes = _mm256_andnot_si256(fours, at_least_three);
+    __m256i twos = _mm256_andnot_si256(at_least_three, at_least_two);
+
+    // flush mask: the ranks of the one suit holding five or more cards, if any
+    __m256i flush_ranks = zero, four = _mm256_set1_epi32(4);
+    __m256i suits[] = {c, d, h, s};
+    for (int suit = 0; suit < SUIT_COUNT; suit++)
+        flush_ranks = _mm256_blendv_epi8(flush_ranks, suits[suit],
+                                         _mm256_cmpgt_epi32(popcount8(suits[suit]), four));
+
+    __m256i flush_tops = straight_tops8(flush_ranks), tops = straight_tops8(ranks);
+    __m256i top_threes = top_bit8(threes), top_twos = top_bit8(twos);
+    __m256i top_threes_bit = _mm256_sllv_epi32(one, top_threes), top_twos_bit = _mm256_sllv_epi32(one, top_twos);
+    __m256i second_twos = top_bit8(_mm256_andnot_si256(top_twos_bit, twos));
+    __m256i top_straight = top_bit8(tops), top_flush = top_bit8(flush_tops);
+
+    // every category is a primary value, a secondary value and kickers taken from the top of a
+    // mask, straights aside; start from high card and let each stronger category that applies
+    // overwrite it
+    __m256i score = zero, primary = zero, primary_count = zero, secondary = zero, secondary_count = zero;
+    __m256i kickers = ranks;
+
+#define EVAL8_SELECT(condition, new_score, new_primary, new_primary_count, new_secondary, new_secondary_count, new_kickers) \
+    do                                                                                                                    \
+    {                                                                                                                     \
+        __m256i select = (condition);                                                                                     \
+        score = _mm256_blendv_epi8(score, _mm256_set1_epi32(new_score), select);                                          \
+        primary = _mm256_blendv_epi8(primary, (new_primary), select);                                                    \
+        primary_count = _mm256_blendv_epi8(primary_count, _mm256_set1_epi32(new_primary_count), select);                 \
+        secondary = _mm256_blendv_epi8(secondary, (new_secondary), select);                                              \
+        secondary_count = _mm256_blendv_epi8(secondary_count, _mm256_set1_epi32(new_secondary_count), select);           \
+        kickers = _mm256_blendv_epi8(kickers, (new_kickers), select);                                                    \
+    } while (0)
+#define EVAL8_NONZERO(x) _mm256_xor_si256(_mm256_cmpeq_epi32((x), zero), _mm256_set1_epi32(-1))
+
+    EVAL8_SELECT(EVAL8_NONZERO(twos), 1, top_twos, 2, zero, 0, _mm256_andnot_si256(top_twos_bit, ranks));
+    EVAL8_SELECT(EVAL8_NONZERO(_mm256_and_si256(twos, _mm256_sub_epi32(twos, one))), 2, top_twos, 2, second_twos, 2,
+                 _mm256_andnot_si256(_mm256_or_si256(top_twos_bit, _mm256_sllv_epi32(one, second_twos)), ranks));
+    EVAL8_SELECT(EVAL8_NONZERO(threes), 3, top_threes, 3, zero, 0, _mm256_andnot_si256(top_threes_bit, ranks));
+    EVAL8_SELECT(EVAL8_NONZERO(tops), 4, zero, 0, zero, 0, zero);
+    EVAL8_SELECT(EVAL8_NONZERO(flush_ranks), 5, zero, 0, zero, 0, flush_ranks);
+
+    // a second three of a kind can only serve as the pair
+    __m256i full_pairs = _mm256_or_si256(_mm256_andnot_si256(top_threes_bit, threes), twos);
+    EVAL8_SELECT(_mm256_andnot_si256(_mm256_cmpeq_epi32(threes, zero), EVAL8_NONZERO(full_pairs)), 6, top_threes, 3,
+                 top_bit8(full_pairs), 2, zero);
+
+    __m256i top_fours = top_bit8(fours);
+    EVAL8_SELECT(EVAL8_NONZERO(fours), 7, top_fours, 4, zero, 0,
+                 _mm256_andnot_si256(_mm256_sllv_epi32(one, top_fours), ranks));
+
+    EVAL8_SELECT(EVAL8_NONZERO(flush_tops), 8, zero, 0, zero, 0, zero);
+    score = _mm256_add_epi32(score, _mm256_and_si256(_mm256_cmpeq_epi32(top_flush, _mm256_set1_epi32(SUIT_RANK_BITS - 1)), one));
+
+#undef EVAL8_SELECT
+#undef EVAL8_NONZERO
+
+    // pack five values: the primary value, then the secondary one, then the highest kickers
+    __m256i vals = zero, secondary_end = _mm256_add_epi32(primary_count, secondary_count);
+    for (int i = 0; i < 5; i++)
+    {
+        __m256i slot = _mm256_set1_epi32(i);
+        __m256i kicker = top_bit8(kickers);
+        __m256i is_primary = _mm256_cmpgt_epi32(primary_count, slot);
+        __m256i is_kicker = _mm256_cmpgt_epi32(_mm256_add_epi32(slot, one), secondary_end);
+
+        __m256i value = _mm256_blendv_epi8(_mm256_blendv_epi8(secondary, kicker, is_kicker), primary, is_primary);
+        kickers = _mm256_andnot_si256(_mm256_and_si256(is_kicker, _mm256_sllv_epi32(one, kicker)), kickers);
+        vals = _mm256_or_si256(_mm256_slli_epi32(vals, STRENGTH_VAL_BITS), value);
+    }
+
+    // straights count down from their top value, as straight_vals does, the wheel ending with
+    // its ace
+    __m256i is_straight_flush = _mm256_cmpgt_epi32(score, _mm256_set1_epi32(7));
+    __m256i is_run = _mm256_or_si256(is_straight_flush, _mm256_cmpeq_epi32(score, four));
+    __m256i run_top = _mm256_blendv_epi8(top_straight, top_flush, is_straight_flush);
+    __m256i run_vals = _mm256_sub_epi32(_mm256_mullo_epi32(run_top, _mm256_set1_epi32(0x11111)), _mm256_set1_epi32(0x01234));
+    run_vals = _mm256_blendv_epi8(run_vals, _mm256_set1_epi32(0x3210C), _mm256_cmpeq_epi32(run_top, _mm256_set1_epi32(3)));
+    vals = _mm256_blendv_epi8(vals, run_vals, is_run);
+
+    __m256i strength = _mm256_or_si256(_mm256_slli_epi32(score, STRENGTH_SCORE_SHIFT), vals);
+    _mm256_storeu_si256((__m256i *)strengths, strength);
+}
+#endif
+
+uint64_t deal_pack(const uint8_t *cards)
+{
+    uint64_t deal = 0;
+    for (int i = DEAL_CARD_COUNT - 1; i >= 0; i--)
+        deal = deal << DEAL_CARD_BITS | cards[i];
+
+    return deal;
+}
+
+size_t deal_unpack(const char **pos, uint8_t *cards)
+{
+    uint64_t deal;
+    memcpy(&deal, *pos, sizeof(deal));
+    *pos += sizeof(deal);
+
+    size_t card_count = 0;
+    for (int i = 0, valid = 1; i < DEAL_CARD_COUNT; i++)
+    {
+        cards[i] = deal >> (DEAL_CARD_BITS * i) & ((1 << DEAL_CARD_BITS) - 1);
+        valid &= cards[i] < CARD_COUNT;
+        card_count += valid;
+    }
+
+    return card_count;
+}
+
+bool deal_file_is_binary(const char *data, size_t size)
+{
+    const DealFileHeader *header = (const DealFileHeader *)data;
+
+    return size >= sizeof(DealFileHeader) && memcmp(header->magic, "PKRDEALS", 8) == 0 &&
+           header->version == DEAL_FILE_VERSION;
+}
+
+bool deal_file_count_matches(const char *data, size_t size)
+{
+    const DealFileHeader *header = (const DealFileHeader *)data;
+
+    return size == sizeof(DealFileHeader) + header->deal_count * sizeof(uint64_t);
+}
+
+int convert_main(int argc, char const *argv[])
+{
+    if (argc != 3)
+    {
+        printf("Usage: poker convert INPUT OUTPUT\n"
+               "  converts text deals to binary deals or binary deals to text, OUTPUT - for stdout,\n"
+               "  which must be seekable for binary deals\n");
+        return EXIT_FAILURE;
+    }
+
+    InputMap input;
+    if (!input_map_open(argv[1], &input))
+    {
+        printf("Could not open %s for input.", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    bool to_text = deal_file_is_binary(input.data, input.size);
+    if (to_text && !deal_file_count_matches(input.data, input.size))
+    {
+        printf("Could not read %s, its deal count does not match its size.", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    bool to_stdout = strcmp(argv[2], "-") == 0;
+    int fd_out = to_stdout ? STDOUT_FILENO : open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_out < 0)
+    {
+        printf("Could not open %s for output.", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    OutputBuffer out = output_buffer_make(OUTPUT_BUF_SIZE);
+    const char *pos = input.data, *end = input.data + input.size;
+    size_t deal_count = 0;
+
+    // binary deals stream out behind a header whose deal count is patched in at the end
+    off_t header_offset = to_text ? 0 : lseek(fd_out, 0, SEEK_CUR);
+    if (header_offset < 0)
+    {
+        printf("Could not write binary deals to %s, the output must be seekable.", argv[2]);
+        return EXIT_FAILURE;
+    }
 
-    if (reverse)
-        for (int i = el_max - 1; i > 0; i--)
-            for (int j = 0; j < counts[i]; j++)
-                vals[val_idx++] = i;
+    if (to_text)
+    {
+        for (pos += sizeof(DealFileHeader); end - pos >= (ptrdiff_t)sizeof(uint64_t);)
+        {
+            uint8_t cards[DEAL_CARD_COUNT];
+            if (deal_unpack(&pos, cards) != DEAL_CARD_COUNT)
+                continue;
+
+            output_reserve(&out, DEAL_LINE_LENGTH + 1);
+            out.len += deal_format(cards, out.data + out.len);
+            deal_count++;
+
+            if (out.len >= OUTPUT_BUF_SIZE / 2)
+                output_write(&out, &fd_out, 1);
+        }
+    }
     else
-        for (int i = 0; i < el_max; i++)
-            for (int j = 0; j < counts[i]; j++)
-                vals[val_idx++] = i;
+    {
+        DealFileHeader header = {
+            .magic = "PKRDEALS",
+            .version = DEAL_FILE_VERSION,
+        };
+        output_reserve(&out, sizeof(header));
+        memcpy(out.data, &header, sizeof(header));
+        out.len = sizeof(header);
+
+        while (pos < end)
+        {
+            uint8_t cards[DEAL_CARD_COUNT];
+            if (parse_deal(&pos, end, cards) != DEAL_CARD_COUNT)
+                continue;
+
+            uint64_t deal = deal_pack(cards);
+            output_reserve(&out, sizeof(deal));
+            memcpy(out.data + out.len, &deal, sizeof(deal));
+            out.len += sizeof(deal);
+            deal_count++;
+
+            if (out.len >= OUTPUT_BUF_SIZE / 2)
+                output_write(&out, &fd_out, 1);
+        }
+    }
+
+    output_write(&out, &fd_out, 1);
+
+    if (!to_text)
+    {
+        DealFileHeader header = {
+            .magic = "PKRDEALS",
+            .version = DEAL_FILE_VERSION,
+            .deal_count = deal_count,
+        };
+        if (pwrite(fd_out, &header, sizeof(header), header_offset) != sizeof(header))
+        {
+            printf("Could not write the header of %s.", argv[2]);
+            return EXIT_FAILURE;
+        }
+    }
+    output_buffer_free(&out);
+    input_map_close(&input);
+
+    if (!to_stdout)
+    {
+        close(fd_out);
+        printf("Converted %zu deals to %s in %s format.\n", deal_count, argv[2], to_text ? "text" : "binary");
+    }
+
+    return EXIT_SUCCESS;
 }
 
-int rank_to_value(char rank)
+void card_format(uint8_t card, char *text)
 {
-    switch (rank)
+    // card indices run through the suits in the order C, D, H, S
+    text[0] = value_to_rank(card_value(card));
+    text[1] = "CDHS"[card / SUIT_RANK_BITS];
+}
+
+size_t deal_format(const uint8_t *cards, char *line)
+{
+    for (size_t i = 0; i < DEAL_CARD_COUNT; i++)
     {
-    case '2':
-        return 0;
-    case '3':
-        return 1;
-    case '4':
-        return 2;
-    case '5':
-        return 3;
-    case '6':
-        return 4;
-    case '7':
-        return 5;
-    case '8':
-        return 6;
-    case '9':
-        return 7;
-    case 'T':
-        return 8;
-    case 'J':
-        return 9;
-    case 'Q':
-        return 10;
-    case 'K':
-        return 11;
-    case 'A':
-        return 12;
-    default:
-        return -1;
+        card_format(cards[i], &line[3 * i]);
+        line[3 * i + 2] = ' ';
     }
+    line[DEAL_LINE_LENGTH] = '\n';
+
+    return DEAL_LINE_LENGTH + 1;
 }
 
-char value_to_rank(int value)
+double time_now(void)
 {
-    switch (value)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+#ifdef POKER_BENCH
+// glibc's own entry points, so that these counting wrappers replace malloc for the whole program
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+void bench_report(const char *name, const char *unit, size_t op_count, double seconds, size_t allocs)
+{
+    printf("%-22s %10zu %-5s %9.2f ns/%-5s %12.0f %s/s", name, op_count, unit, seconds * 1e9 / op_count, unit,
+           op_count / seconds, unit);
+
+#ifdef POKER_BENCH
+    printf(" %10.6f allocs/%s\n", (double)allocs / op_count, unit);
+#else
+    (void)allocs;
+    printf("\n");
+#endif
+}
+
+int bench_main(int argc, char const *argv[])
+{
+    eval_tables_init();
+
+#ifndef POKER_BENCH
+    printf("Allocations are only counted in builds with -DPOKER_BENCH, as made by make bench.\n");
+#endif
+
+    // random deals in both card and text form for the stage benchmarks
+    size_t deal_count = BENCH_BLOCK_DEALS, allocs;
+    uint64_t rng = 1;
+    uint8_t *cards = malloc(deal_count * DEAL_CARD_COUNT);
+    char *text = malloc(deal_count * (DEAL_LINE_LENGTH + 1));
+    for (size_t i = 0; i < deal_count; i++)
     {
-    case 0:
-        return '2';
-    case 1:
-        return '3';
-    case 2:
-        return '4';
-    case 3:
-        return '5';
-    case 4:
-        return '6';
-    case 5:
-        return '7';
-    case 6:
-        return '8';
-    case 7:
-        return '9';
-    case 8:
-        return 'T';
-    case 9:
-        return 'J';
-    case 10:
-        return 'Q';
-    case 11:
-        return 'K';
-    case 12:
-        return 'A';
-    default:
-        return '\0';
+        deal_random(&rng, DEAL_CARD_COUNT, &cards[i * DEAL_CARD_COUNT]);
+        deal_format(&cards[i * DEAL_CARD_COUNT], &text[i * (DEAL_LINE_LENGTH + 1)]);
+    }
+
+    Play *plays = malloc(2 * deal_count * sizeof(Play));
+    Hand *hands = malloc(2 * deal_count * sizeof(Hand));
+    uint32_t *strengths = malloc(2 * deal_count * sizeof(uint32_t));
+    uint64_t checksum = 0;
+    double start;
+
+    printf("Stages, %zu random deals:\n", deal_count);
+
+    allocs = alloc_count, start = time_now();
+    for (size_t i = 0; i < deal_count * DEAL_CARD_COUNT; i++)
+        checksum += card_parse(text[3 * i], text[3 * i + 1]);
+    bench_report("card_parse", "card", deal_count * DEAL_CARD_COUNT, time_now() - start, alloc_count - allocs);
+
+    allocs = alloc_count, start = time_now();
+    for (const char *pos = text, *end = text + deal_count * (DEAL_LINE_LENGTH + 1); pos < end;)
+    {
+        uint8_t line_cards[DEAL_CARD_COUNT];
+        checksum += parse_deal(&pos, end, line_cards) + line_cards[9];
+    }
+    bench_report("parse_deal", "deal", deal_count, time_now() - start, alloc_count - allocs);
+
+    allocs = alloc_count, start = time_now();
+    for (size_t i = 0; i < 2 * deal_count; i++)
+        plays[i] = calculate_play(5, &cards[5 * i]);
+    bench_report("calculate_play", "hand", 2 * deal_count, time_now() - start, alloc_count - allocs);
+
+    allocs = alloc_count, start = time_now();
+    for (size_t i = 0; i < deal_count; i++)
+        checksum += play_cmp(&plays[2 * i], &plays[2 * i + 1]) > 0;
+    bench_report("play_cmp", "deal", deal_count, time_now() - start, alloc_count - allocs);
+
+    for (size_t i = 0; i < 2 * deal_count; i++)
+        hands[i] = hand_make(5, &cards[5 * i]);
+
+    allocs = alloc_count, start = time_now();
+    evaluate_batch(hands, strengths, 2 * deal_count);
+    bench_report("evaluate_batch", "hand", 2 * deal_count, time_now() - start, alloc_count - allocs);
+
+    OutputBuffer out = output_buffer_make(OUTPUT_BUF_SIZE);
+    allocs = alloc_count, start = time_now();
+    for (size_t i = 0; i < deal_count; i++)
+    {
+        if (out.len > OUTPUT_BUF_SIZE - DEAL_TEXT_MAX)
+            out.len = 0;
+
+        output_reserve(&out, DEAL_TEXT_MAX);
+        output_play(&out, "(Player) ", &cards[10 * i], &plays[2 * i]);
+        output_play(&out, "(Other)  ", &cards[10 * i + 5], &plays[2 * i + 1]);
+        output_str(&out, play_cmp(&plays[2 * i], &plays[2 * i + 1]) > 0 ? "Player won!\n\n" : "Other won!\n\n");
+    }
+    bench_report("output_play", "deal", deal_count, time_now() - start, alloc_count - allocs);
+    output_buffer_free(&out);
+
+    // whole runs over text corpora, generated a block at a time outside of the timing
+    int fd_null = open("/dev/null", O_WRONLY);
+    Options options = {.threads = threads_default()};
+    const char *default_sizes[] = {"1000000", "10000000", "100000000"};
+    const char **sizes = argc > 1 ? &argv[1] : default_sizes;
+    int size_count = argc > 1 ? argc - 1 : 3;
+
+    printf("End to end, text deals to formatted output on %ld threads:\n", options.threads);
+    for (int i = 0; i < size_count; i++)
+    {
+        size_t corpus_deals = strtoull(sizes[i], NULL, 10), done = 0;
+        double seconds = 0;
+        Tally tally = {0};
+        allocs = 0;
+
+        while (done < corpus_deals)
+        {
+            size_t block_deals = corpus_deals - done < deal_count ? corpus_deals - done : deal_count;
+            for (size_t j = 0; j < block_deals; j++)
+            {
+                deal_random(&rng, DEAL_CARD_COUNT, &cards[j * DEAL_CARD_COUNT]);
+                deal_format(&cards[j * DEAL_CARD_COUNT], &text[j * (DEAL_LINE_LENGTH + 1)]);
+            }
+
+            size_t block_allocs = alloc_count;
+            start = time_now();
+            Tally block_tally = run_deals(text, text + block_deals * (DEAL_LINE_LENGTH + 1), &options, &fd_null, 1);
+            seconds += time_now() - start;
+            allocs += alloc_count - block_allocs;
+
+            tally_merge(&tally, &block_tally);
+            done += block_deals;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "corpus %s", sizes[i]);
+        bench_report(name, "hand", 2 * corpus_deals, seconds, allocs);
+        checksum += tally.wins;
     }
+
+    printf("Checksum %llu\n", (unsigned long long)checksum);
+
+    close(fd_null);
+    free(cards);
+    free(text);
+    free(plays);
+    free(hands);
+    free(strengths);
+
+    return EXIT_SUCCESS;
 }
 
-int count_to_n_pairs(int count)
+void *generate_worker(void *arg)
 {
-    switch (count)
+    GenerateJob *job = arg;
+
+    uint64_t rng = thread_seed(job->seed, job->block);
+
+    // the text of every card with a trailing space, written 4 bytes at a time
+    uint32_t card_text[CARD_COUNT];
+    uint8_t deck[CARD_COUNT];
+    for (int card = 0; card < CARD_COUNT; card++)
     {
-    case 0:
-        return 0;
-    case 1:
-        return 0;
-    case 2:
-        return 1;
-    case 3:
-        return 3;
-    case 4:
-        return 6;
-    default:
-        return -1;
+        char text[4] = {0, 0, ' ', ' '};
+        card_format(card, text);
+        memcpy(&card_text[card], text, 4);
+        deck[card] = card;
     }
-}
 
-int n_pairs_to_score(int n_pairs)
-{
-    switch (n_pairs)
+    size_t deal_size = job->binary ? sizeof(uint64_t) : DEAL_LINE_LENGTH + 1;
+    job->out.len = 0;
+    output_reserve(&job->out, job->deal_count * deal_size + 1);
+    char *p = job->out.data;
+
+    for (size_t i = 0; i < job->deal_count; i++)
     {
-    case 0:
-        return 0;
-    case 1:
-        return 1;
-    case 2:
-        return 2;
-    case 3:
-        return 3;
-    case 4:
-        return 6;
-    case 6:
-        return 7;
-    default:
-        return -1;
+        deck_deal_partial(deck, CARD_COUNT, DEAL_CARD_COUNT, &rng);
+
+        if (job->binary)
+        {
+            uint64_t deal = deal_pack(deck);
+            memcpy(p, &deal, sizeof(deal));
+        }
+        else
+        {
+            for (int j = 0; j < DEAL_CARD_COUNT; j++)
+                memcpy(p + 3 * j, &card_text[deck[j]], 4);
+            p[DEAL_LINE_LENGTH] = '\n';
+        }
+        p += deal_size;
     }
+
+    job->out.len = p - job->out.data;
+
+    return NULL;
 }
 
-char *score_to_play_string(int score)
+int generate_main(int argc, char const *argv[])
 {
-    switch (score)
+    size_t deal_count = 0;
+    uint64_t seed = 1;
+    long threads = threads_default();
+    bool binary = false, count_given = false;
+    const char *output_path = "-";
+
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--binary") == 0)
+            binary = true;
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 0);
+        else if (threads_option(argc, argv, &i, &threads))
+            continue;
+        else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc)
+            output_path = argv[++i];
+        else if (!count_given && argv[i][0] != '-')
+        {
+            char *count_end;
+            deal_count = strtoull(argv[i], &count_end, 10);
+            count_given = count_end != argv[i] && *count_end == '\0';
+            if (!count_given)
+                i = argc;
+        }
+        else
+            count_given = false, i = argc;
+
+    if (!count_given)
     {
-    case 0:
-        return "High Card";
-    case 1:
-        return "Pair";
-    case 2:
-        return "Two Pair";
-    case 3:
-        return "Three of a Kind";
-    case 4:
-        return "Straight";
-    case 5:
-        return "Flush";
-    case 6:
-        return "Full House";
-    case 7:
-        return "Four of a Kind";
-    case 8:
-        return "Straight Flush";
-    case 9:
-        return "Royal Flush";
-    default:
-        return NULL;
+        printf("Usage: poker generate COUNT [--seed S] [--binary] [-j | --threads N] [-o | --output FILE]\n"
+               "  writes COUNT random deals, the same ones for the same seed (default: 1), as text\n"
+               "  or binary deals to FILE (default: stdout)\n");
+        return EXIT_FAILURE;
+    }
+
+    bool to_stdout = strcmp(output_path, "-") == 0;
+    int fd_out = to_stdout ? STDOUT_FILENO : open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_out < 0)
+    {
+        printf("Could not open %s for output.", output_path);
+        return EXIT_FAILURE;
+    }
+
+    double start = time_now();
+    size_t bytes = 0;
+
+    if (binary)
+    {
+        DealFileHeader header = {
+            .magic = "PKRDEALS",
+            .version = DEAL_FILE_VERSION,
+            .deal_count = deal_count,
+        };
+        OutputBuffer out = {.data = (char *)&header, .len = sizeof(header)};
+        output_write(&out, &fd_out, 1);
+        bytes += sizeof(header);
     }
+
+    // every round generates one block per thread, then writes the blocks out in order
+    GenerateJob *jobs = calloc(threads, sizeof(GenerateJob));
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    for (long t = 0; t < threads; t++)
+        jobs[t] = (GenerateJob){.seed = seed, .binary = binary, .out = output_buffer_make(OUTPUT_BUF_SIZE)};
+
+    for (size_t block = 0; block * GENERATE_BLOCK_DEALS < deal_count; block += threads)
+    {
+        long started = 0;
+        for (; started < threads && (block + started) * GENERATE_BLOCK_DEALS < deal_count; started++)
+        {
+            GenerateJob *job = &jobs[started];
+            job->block = block + started;
+            job->deal_count = deal_count - job->block * GENERATE_BLOCK_DEALS;
+            if (job->deal_count > GENERATE_BLOCK_DEALS)
+                job->deal_count = GENERATE_BLOCK_DEALS;
+
+            if (threads == 1)
+                generate_worker(job);
+            else
+                pthread_create(&workers[started], NULL, generate_worker, job);
+        }
+
+        for (long t = 0; t < started; t++)
+        {
+            if (threads > 1)
+                pthread_join(workers[t], NULL);
+            bytes += jobs[t].out.len;
+            output_write(&jobs[t].out, &fd_out, 1);
+        }
+    }
+
+    double seconds = time_now() - start;
+
+    for (long t = 0; t < threads; t++)
+        output_buffer_free(&jobs[t].out);
+    free(jobs);
+    free(workers);
+
+    if (!to_stdout)
+    {
+        close(fd_out);
+        printf("Generated %zu deals, %zu MB, in %.3f s, %.0f MB/s\n", deal_count, bytes >> 20, seconds,
+               bytes / seconds / (1 << 20));
+    }
+
+    return EXIT_SUCCESS;
 }
 
-Card card_make(char rank, char suit)
+Strength reference_strength(const uint8_t *cards)
 {
-    return (Card){
-        .rank = rank,
-        .value = rank_to_value(rank),
-        .suit = suit,
-    };
+    int vals[5], counts[5];
+    bool flush = true;
+    for (int i = 0; i < 5; i++)
+    {
+        vals[i] = card_value(cards[i]);
+        flush &= cards[i] / SUIT_RANK_BITS == cards[0] / SUIT_RANK_BITS;
+    }
+    for (int i = 0; i < 5; i++)
+    {
+        counts[i] = 0;
+        for (int j = 0; j < 5; j++)
+            counts[i] += vals[j] == vals[i];
+    }
+
+    // the most frequent values first, the highest first among values as frequent
+    for (int i = 1; i < 5; i++)
+        for (int j = i; j > 0 && (counts[j] > counts[j - 1] || (counts[j] == counts[j - 1] && vals[j] > vals[j - 1])); j--)
+        {
+            int swap = vals[j];
+            vals[j] = vals[j - 1];
+            vals[j - 1] = swap;
+            swap = counts[j];
+            counts[j] = counts[j - 1];
+            counts[j - 1] = swap;
+        }
+
+    bool wheel = counts[0] == 1 && vals[0] == 12 && vals[1] == 3 && vals[4] == 0;
+    bool straight = counts[0] == 1 && (vals[0] - vals[4] == 4 || wheel);
+    if (wheel)
+    {
+        for (int i = 0; i < 4; i++)
+            vals[i] = vals[i + 1];
+        vals[4] = 12;
+    }
+
+    int score;
+    if (straight && flush)
+        score = vals[0] == 12 ? 9 : 8;
+    else if (counts[0] == 4)
+        score = 7;
+    else if (counts[0] == 3 && counts[3] == 2)
+        score = 6;
+    else if (flush)
+        score = 5;
+    else if (straight)
+        score = 4;
+    else if (counts[0] == 3)
+        score = 3;
+    else if (counts[0] == 2 && counts[2] == 2)
+        score = 2;
+    else
+        score = counts[0] == 2;
+
+    Strength strength = score;
+    for (int i = 0; i < 5; i++)
+        strength = strength << STRENGTH_VAL_BITS | vals[i];
+
+    return strength;
 }
 
-int *cards_get_values(size_t card_count, Card *cards)
+Strength best_subset_strength(size_t card_count, const uint8_t *cards)
 {
-    int *values = malloc(sizeof(int) * card_count);
+    if (card_count == 5)
+        return reference_strength(cards);
 
+    // every subset leaves out card_count - 5 cards, i and j, with j = i for 6 cards
+    Strength best = 0;
     for (size_t i = 0; i < card_count; i++)
-        values[i] = cards[i].value;
+        for (size_t j = card_count == 7 ? i + 1 : i; j < (card_count == 7 ? card_count : i + 1); j++)
+        {
+            uint8_t five[5];
+            size_t five_count = 0;
+            for (size_t k = 0; k < card_count; k++)
+                if (k != i && k != j)
+                    five[five_count++] = cards[k];
+
+            Strength strength = reference_strength(five);
+            best = strength > best ? strength : best;
+        }
 
-    return values;
+    return best;
 }
 
-char *cards_get_suits(size_t card_count, Card *cards)
+bool fuzz_check_deal(const uint8_t *cards, const StateTable *table, char *report)
 {
-    char *suits = malloc(sizeof(char) * card_count);
+    // the two 5 card hands of the deal, then hands of 5 to 7 cards running across both
+    const size_t firsts[FUZZ_HAND_COUNT] = {0, 5, 0, 3, 0, 4, 1, 2};
+    const size_t counts[FUZZ_HAND_COUNT] = {5, 5, 7, 7, 6, 6, 5, 5};
 
-    for (size_t i = 0; i < card_count; i++)
-        suits[i] = cards[i].suit;
+    Hand hands[FUZZ_HAND_COUNT];
+    Strength expected[FUZZ_HAND_COUNT], batch[FUZZ_HAND_COUNT];
+    for (int i = 0; i < FUZZ_HAND_COUNT; i++)
+    {
+        hands[i] = hand_make(counts[i], &cards[firsts[i]]);
+        expected[i] = best_subset_strength(counts[i], &cards[firsts[i]]);
+    }
+
+    evaluate_batch(hands, batch, FUZZ_HAND_COUNT);
+
+    char deal_text[DEAL_LINE_LENGTH + 1];
+    deal_format(cards, deal_text);
+    deal_text[DEAL_LINE_LENGTH] = '\0';
+
+    for (int i = 0; i < FUZZ_HAND_COUNT; i++)
+    {
+        const char *path = NULL;
+        Strength got = 0;
+
+        if ((got = hand_best_strength(hands[i])) != expected[i])
+            path = "hand_best_strength";
+        else if ((got = batch[i]) != expected[i])
+            path = "evaluate_batch";
+        else if (counts[i] == 5 && (got = hand_strength(hands[i])) != expected[i])
+            path = "hand_strength";
+        else if ((got = calculate_strength(counts[i], &cards[firsts[i]])) != expected[i])
+            path = "calculate_strength";
+        else if (table && (got = class_strengths[state_table_class(table, counts[i], &cards[firsts[i]])]) != expected[i])
+            path = "state_table_class";
+
+        if (path)
+        {
+            snprintf(report, FUZZ_REPORT_MAX,
+                     "Divergence on deal %s: %s gives %05X for the %zu cards from card %zu, the reference %05X\n",
+                     deal_text, path, got, counts[i], firsts[i] + 1, expected[i]);
+            return false;
+        }
+    }
 
-    return suits;
+    return true;
 }
 
-int *cards_get_value_counts(size_t card_count, Card *cards)
+bool fuzz_check_parse(const char *line, const char *end, char *report)
 {
-    int *value_counts = calloc(RANK_COUNT, sizeof(int));
+#ifdef PARSE_SIMD
+    if (end - line < 32 || !__builtin_cpu_supports("sse4.1"))
+        return true;
 
-    for (size_t i = 0; i < card_count; i++)
-        value_counts[cards[i].value]++;
+    uint8_t simd_cards[DEAL_CARD_COUNT], scalar_cards[DEAL_CARD_COUNT];
+    const char *scalar_pos = line;
+    bool simd_ok = parse_deal_sse41(line, simd_cards);
+    size_t scalar_count = parse_deal_scalar(&scalar_pos, end, scalar_cards);
+
+    // a line in the fixed layout has a separator after every card and its newline at the end
+    bool fixed_layout = scalar_count == DEAL_CARD_COUNT && line[DEAL_LINE_LENGTH] == '\n';
+    for (size_t i = 0; i < DEAL_CARD_COUNT - 1 && fixed_layout; i++)
+        fixed_layout = line[3 * i + 2] == ' ';
+
+    const char *divergence = simd_ok != fixed_layout ? (simd_ok ? "only parse_deal_sse41 accepts"
+                                                                : "only the scalar parser accepts")
+                             : simd_ok && memcmp(simd_cards, scalar_cards, DEAL_CARD_COUNT) != 0
+                                 ? "the parsers read different cards from"
+                                 : NULL;
+    if (divergence)
+    {
+        snprintf(report, FUZZ_REPORT_MAX, "Divergence on line \"%.*s\": %s it\n", DEAL_LINE_LENGTH, line,
+                 divergence);
+        return false;
+    }
+#endif
 
-    return value_counts;
+    return true;
 }
 
-Play calc_pairs(size_t card_count, Card *cards)
+// set by the first thread to find a divergence, so that the others stop as well
+bool fuzz_stop;
+
+void *fuzz_worker(void *arg)
 {
-    int *counts = cards_get_value_counts(card_count, cards);
+    FuzzJob *job = arg;
+    uint64_t rng = job->seed;
 
-    int n_pairs = 0;
-    for (size_t i = 0; i < RANK_COUNT; i++)
-        n_pairs += count_to_n_pairs(counts[i]);
+    while (job->deals_checked < job->deal_limit && !__atomic_load_n(&fuzz_stop, __ATOMIC_RELAXED))
+    {
+        // check the clock only once in a while
+        if (job->deals_checked % 4096 == 0 && time_now() > job->end_time)
+            break;
 
-    int play_val_count = 0, high_val_count = 0;
-    for (size_t i = 0; i < RANK_COUNT; i++)
-        if (counts[i] > 1)
-            play_val_count += counts[i];
-        else
-            high_val_count += counts[i];
-
-    size_t play_val_idx = 0;
-    int *play_vals = malloc(play_val_count * sizeof(int));
-    for (size_t i = 0; i < RANK_COUNT; i++)
-        if (counts[i] > 1)
-            for (size_t j = 0; j < counts[i]; j++)
-                play_vals[play_val_idx++] = i;
-
-    size_t high_val_idx = 0;
-    int *high_vals = malloc(high_val_count * sizeof(int));
-    for (size_t i = 0; i < RANK_COUNT; i++)
-        if (counts[i] == 1)
-            for (size_t j = 0; j < counts[i]; j++)
-                high_vals[high_val_idx++] = i;
-
-    free(counts);
-
-    return (Play){
-        .score = n_pairs_to_score(n_pairs),
-        .play_vals = play_vals,
-        .play_val_count = play_val_count,
-        .high_vals = high_vals,
-        .high_val_count = high_val_count,
-    };
+        uint8_t cards[DEAL_CARD_COUNT];
+        deal_random(&rng, DEAL_CARD_COUNT, cards);
+        job->deals_checked++;
+
+        // the text of the deal goes through both parsers, every other time with one byte changed
+        char line[32] = {0};
+        deal_format(cards, line);
+        uint64_t r = rng_next(&rng);
+        if (r & 1)
+            line[(r >> 8) % (DEAL_LINE_LENGTH + 1)] = r >> 16;
+
+        if (!fuzz_check_parse(line, line + sizeof(line), job->report) ||
+            !fuzz_check_deal(cards, job->table, job->report))
+        {
+            job->diverged = true;
+            __atomic_store_n(&fuzz_stop, true, __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
 }
 
-bool is_straight(size_t card_count, Card *cards)
+int fuzz_main(int argc, char const *argv[])
 {
-    int *values = cards_get_values(card_count, cards);
+    size_t deal_limit = SIZE_MAX;
+    double seconds = 10;
+    uint64_t seed = 1;
+    long threads = threads_default();
+    const char *states_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--deals") == 0 && i + 1 < argc)
+        {
+            deal_limit = strtoull(argv[++i], NULL, 10);
+            seconds = 1e30;
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            seconds = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--states") == 0 && i + 1 < argc)
+            states_path = argv[++i];
+        else if (threads_option(argc, argv, &i, &threads))
+            continue;
+        else
+        {
+            printf("Usage: poker fuzz [--seed S] [--deals N | --seconds T] [--states FILE] [-j | --threads N]\n"
+                   "  checks random deals against a reference evaluator and their text against the\n"
+                   "  scalar parser until N deals or T seconds (default: 10) have passed or an\n"
+                   "  evaluator or the parsers diverge; --states checks a state table too\n");
+            return EXIT_FAILURE;
+        }
 
-    counting_sort(values, card_count, RANK_COUNT, false);
+    eval_tables_init();
 
-    int prev_value = values[0];
-    for (size_t i = 1; i < card_count; i++)
+    StateTable table, *table_ptr = NULL;
+    if (states_path)
     {
-        if (prev_value + 1 != values[i])
+        if (!state_table_open(states_path, &table))
         {
-            free(values);
-            return false;
+            printf("Could not open or build state table %s.\n", states_path);
+            return EXIT_FAILURE;
         }
+        table_ptr = &table;
+    }
 
-        prev_value = values[i];
+    double start = time_now();
+    FuzzJob *jobs = calloc(threads, sizeof(FuzzJob));
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    for (long t = 0; t < threads; t++)
+    {
+        // threads share the deal limit and draw from sequences far apart
+        jobs[t] = (FuzzJob){
+            .seed = thread_seed(seed, t),
+            .deal_limit = deal_limit / threads + ((size_t)t < deal_limit % threads),
+            .end_time = start + seconds,
+            .table = table_ptr,
+        };
+        pthread_create(&workers[t], NULL, fuzz_worker, &jobs[t]);
     }
 
-    free(values);
-    return true;
+    size_t deals_checked = 0;
+    bool diverged = false;
+    for (long t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t], NULL);
+        deals_checked += jobs[t].deals_checked;
+        if (jobs[t].diverged && !diverged)
+        {
+            printf("%s", jobs[t].report);
+            diverged = true;
+        }
+    }
+
+    double elapsed = time_now() - start;
+    printf("Checked %zu deals with seed %llu on %ld threads in %.1f s, %.0f deals/s, %s\n", deals_checked,
+           (unsigned long long)seed, threads, elapsed, deals_checked / elapsed,
+           diverged ? "stopped at the first divergence" : "no divergence");
+
+    free(jobs);
+    free(workers);
+    if (table_ptr)
+        state_table_close(table_ptr);
+
+    return diverged ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
-bool is_flush(size_t card_count, Card *cards)
+void combination_unrank(size_t rank, size_t k, size_t n, uint8_t *cards)
 {
-    char *suits = cards_get_suits(card_count, cards);
-
-    char prev_suit = suits[0];
-    for (size_t i = 1; i < card_count; i++)
-        if (prev_suit != suits[i])
+    size_t c = 0;
+    for (size_t i = 0; i < k; i++)
+    {
+        // skip every combination whose element i is c, of which there are n - c - 1 choose k - i - 1
+        for (;; c++)
         {
-            free(suits);
-            return false;
+            size_t following = 1;
+            for (size_t j = 0; j < k - i - 1; j++)
+                following = following * (n - c - 1 - j) / (j + 1);
+
+            if (rank < following)
+                break;
+            rank -= following;
         }
 
-    free(suits);
+        cards[i] = c++;
+    }
+}
+
+bool combination_next(uint8_t *cards, size_t k, size_t n)
+{
+    // find the last element that can still move up, then restart everything after it
+    size_t i = k;
+    while (i > 0 && cards[i - 1] == n - k + i - 1)
+        i--;
+    if (i == 0)
+        return false;
+
+    cards[i - 1]++;
+    for (size_t j = i; j < k; j++)
+        cards[j] = cards[j - 1] + 1;
+
     return true;
 }
 
-bool is_royal(size_t card_count, Card *cards)
+void *exhaustive_worker(void *arg)
 {
-    int *values = cards_get_values(card_count, cards);
+    ExhaustiveJob *job = arg;
+    uint8_t cards[PLAY_CARD_COUNT];
+    combination_unrank(job->first, PLAY_CARD_COUNT, CARD_COUNT, cards);
+
+    if (!job->check)
+    {
+        for (size_t i = 0; i < job->hand_count; i++, combination_next(cards, PLAY_CARD_COUNT, CARD_COUNT))
+            job->score_counts[strength_to_score(calculate_play(PLAY_CARD_COUNT, cards).strength)]++;
+
+        return NULL;
+    }
 
-    counting_sort(values, card_count, RANK_COUNT, false);
+    // hands go through evaluate_batch a batch at a time, everything else one by one
+    uint8_t batch_cards[EXHAUSTIVE_BATCH][PLAY_CARD_COUNT];
+    Hand hands[EXHAUSTIVE_BATCH];
+    Strength batch[EXHAUSTIVE_BATCH];
+
+    for (size_t done = 0; done < job->hand_count;)
+    {
+        size_t batch_count = job->hand_count - done < EXHAUSTIVE_BATCH ? job->hand_count - done : EXHAUSTIVE_BATCH;
+        for (size_t i = 0; i < batch_count; i++, combination_next(cards, PLAY_CARD_COUNT, CARD_COUNT))
+        {
+            memcpy(batch_cards[i], cards, PLAY_CARD_COUNT);
+            hands[i] = hand_make(PLAY_CARD_COUNT, cards);
+        }
 
-    char royal_ranks[] = {'T', 'J', 'Q', 'K', 'A'};
+        evaluate_batch(hands, batch, batch_count);
 
-    for (size_t i = 0; i < card_count; i++)
-        if (values[i] != rank_to_value(royal_ranks[i]))
+        for (size_t i = 0; i < batch_count; i++)
         {
-            free(values);
-            return false;
+            Strength strength = reference_strength(batch_cards[i]);
+            int score = strength_to_score(strength);
+
+            bool matches = calculate_play(PLAY_CARD_COUNT, batch_cards[i]).strength == strength &&
+                           hand_strength(hands[i]) == strength && hand_best_strength(hands[i]) == strength &&
+                           batch[i] == strength && is_straight(hands[i]) == (score == 4 || score >= 8) &&
+                           is_flush(hands[i]) == (score == 5 || score >= 8) && is_royal(hands[i]) == (score == 9);
+            if (!matches && job->mismatches++ == 0)
+                memcpy(job->first_mismatch, batch_cards[i], PLAY_CARD_COUNT);
         }
 
-    free(values);
-    return true;
+        done += batch_count;
+    }
+
+    return NULL;
 }
 
-Play calculate_play(size_t card_count, Card *cards)
+int exhaustive_main(int argc, char const *argv[])
 {
-    int *values = cards_get_values(card_count, cards);
-    char *suits = cards_get_suits(card_count, cards);
+    long threads = threads_default();
 
-    Play curr_play = calc_pairs(card_count, cards); // TODO fix
+    for (int i = 1; i < argc; i++)
+        if (threads_option(argc, argv, &i, &threads))
+            continue;
+        else
+        {
+            printf("Usage: poker exhaustive [-j | --threads N]\n"
+                   "  evaluates all %d 5 card hands, checks the number of every play and cross checks\n"
+                   "  every evaluator against a reference evaluator\n",
+                   EXHAUSTIVE_HAND_COUNT);
+            return EXIT_FAILURE;
+        }
 
-    bool curr_is_straight = is_straight(card_count, cards);
-    if (curr_is_straight && curr_play.score < 4)
-        curr_play = (Play){
-            .score = 4,
-            .play_val_count = card_count,
-            .play_vals = values,
-        };
+    eval_tables_init();
 
-    bool curr_is_flush = is_flush(card_count, cards);
-    if (curr_is_flush && curr_play.score < 5)
-        curr_play = (Play){
-            .score = 5,
-            .play_val_count = card_count,
-            .play_vals = values,
-        };
+    ExhaustiveJob *jobs = calloc(threads, sizeof(ExhaustiveJob));
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    size_t score_counts[SCORE_COUNT] = {0}, mismatches = 0;
+    uint8_t first_mismatch[PLAY_CARD_COUNT];
+    double seconds[2];
 
-    if (curr_is_straight && curr_is_flush)
+    // a timed pass that only evaluates and counts, then a pass that checks the other evaluators
+    for (int pass = 0; pass < 2; pass++)
     {
-        curr_play = (Play){
-            .score = 8,
-            .play_val_count = card_count,
-            .play_vals = values,
-        };
-
-        if (is_royal(card_count, cards))
-            curr_play = (Play){
-                .score = 9,
+        double start = time_now();
+        for (long t = 0; t < threads; t++)
+        {
+            size_t first = EXHAUSTIVE_HAND_COUNT * t / threads;
+            jobs[t] = (ExhaustiveJob){
+                .first = first,
+                .hand_count = EXHAUSTIVE_HAND_COUNT * (t + 1) / threads - first,
+                .check = pass == 1,
             };
+            pthread_create(&workers[t], NULL, exhaustive_worker, &jobs[t]);
+        }
+
+        for (long t = 0; t < threads; t++)
+        {
+            pthread_join(workers[t], NULL);
+            for (int score = 0; score < SCORE_COUNT && !jobs[t].check; score++)
+                score_counts[score] += jobs[t].score_counts[score];
+            if (jobs[t].mismatches && mismatches == 0)
+                memcpy(first_mismatch, jobs[t].first_mismatch, PLAY_CARD_COUNT);
+            mismatches += jobs[t].mismatches;
+        }
+        seconds[pass] = time_now() - start;
+    }
+
+    bool counts_match = true;
+    printf("%-16s %10s %10s\n", "Play", "Hands", "Expected");
+    for (int score = 0; score < SCORE_COUNT; score++)
+    {
+        counts_match &= score_counts[score] == EXHAUSTIVE_SCORE_COUNTS[score];
+        printf("%-16s %10zu %10zu%s\n", score_to_play_string(score), score_counts[score],
+               EXHAUSTIVE_SCORE_COUNTS[score], score_counts[score] == EXHAUSTIVE_SCORE_COUNTS[score] ? "" : " wrong");
+    }
+
+    if (mismatches)
+    {
+        char hand_text[3 * PLAY_CARD_COUNT + 1];
+        for (int i = 0; i < PLAY_CARD_COUNT; i++)
+        {
+            card_format(first_mismatch[i], &hand_text[3 * i]);
+            hand_text[3 * i + 2] = ' ';
+        }
+        hand_text[3 * PLAY_CARD_COUNT - 1] = '\0';
+        printf("%zu hands where an evaluator disagrees with reference_strength, the first being %s\n", mismatches,
+               hand_text);
     }
 
-    free(values); // may be an issue because return play with values
-    free(suits);
+    printf("Evaluated %d hands on %ld threads in %.1f ms, %.1f M hands/s, checked every evaluator in %.1f ms\n",
+           EXHAUSTIVE_HAND_COUNT, threads, seconds[0] * 1e3, EXHAUSTIVE_HAND_COUNT / seconds[0] / 1e6,
+           seconds[1] * 1e3);
 
-    return curr_play;
+    free(jobs);
+    free(workers);
+
+    return counts_match && mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-int high_vals_cmp(Play *a, Play *b)
+int cards_parse_arg(const char *text, uint8_t *cards, int max_count, Hand *used)
 {
-    counting_sort(a->high_vals, a->high_val_count, RANK_COUNT, true);
-    counting_sort(b->high_vals, b->high_val_count, RANK_COUNT, true);
+    int card_count = 0;
 
-    size_t i = 0;
-    while (i < a->high_val_count && i < b->high_val_count)
+    while (*text)
     {
-        if (a->high_vals[i] != b->high_vals[i])
-            return a->high_vals[i] - b->high_vals[i];
+        if (*text == ' ' || *text == ',')
+        {
+            text++;
+            continue;
+        }
 
-        i++;
+        uint8_t card = text[1] ? card_parse(text[0], text[1]) : CARD_INVALID;
+        if (card >= CARD_INVALID || card_count == max_count || *used >> card & 1)
+            return -1;
+
+        *used |= (Hand)1 << card;
+        cards[card_count++] = card;
+        text += 2;
     }
 
-    return a->high_val_count - b->high_val_count;
+    return card_count;
 }
 
-int play_vals_cmp(Play *a, Play *b)
+void *equity_worker(void *arg)
 {
-    counting_sort(a->play_vals, a->play_val_count, RANK_COUNT, true);
-    counting_sort(b->play_vals, b->play_val_count, RANK_COUNT, true);
+    EquityJob *job = arg;
+    uint64_t rng = job->seed;
+    uint8_t *deck = job->deck, *other = job->other;
+    size_t unknown = PLAY_CARD_COUNT - job->other_known, wins = 0, ties = 0;
 
-    size_t i = 0;
-    while (i < a->play_val_count && i < b->play_val_count)
+    for (size_t i = 0; i < job->trials; i++)
     {
-        if (a->play_vals[i] != b->play_vals[i])
-            return a->play_vals[i] - b->play_vals[i];
+        // the unknown cards come from the rest of the deck
+        deck_deal_partial(deck, job->deck_count, unknown, &rng);
+        for (size_t j = 0; j < unknown; j++)
+            other[job->other_known + j] = deck[j];
 
-        i++;
+        // classes order hands like play_cmp, so comparing them settles the trial
+        uint16_t other_class = eval5_class(other[0], other[1], other[2], other[3], other[4]);
+        wins += job->player_class > other_class;
+        ties += job->player_class == other_class;
     }
 
-    return a->play_val_count - b->play_val_count;
+    job->wins = wins;
+    job->ties = ties;
+    job->losses = job->trials - wins - ties;
+
+    return NULL;
 }
 
-int play_cmp(Play *a, Play *b)
+void equity_report(const char *name, double mean, size_t trials)
+{
+    double z2 = EQUITY_Z * EQUITY_Z / trials;
+    double center = (mean + z2 / 2) / (1 + z2);
+    double margin = EQUITY_Z * sqrt(mean * (1 - mean) / trials + z2 / (4 * trials)) / (1 + z2);
+
+    printf("%-7s %7.3f%%  [%7.3f%%, %7.3f%%]\n", name, 100 * mean, 100 * fmax(center - margin, 0),
+           100 * fmin(center + margin, 1));
+}
+
+int equity_main(int argc, char const *argv[])
+{
+    size_t trials = EQUITY_TRIALS;
+    uint64_t seed = 1;
+    long threads = threads_default();
+    const char *hand_args[2] = {NULL, NULL};
+    int hand_arg_count = 0;
+
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc)
+            trials = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 0);
+        else if (threads_option(argc, argv, &i, &threads))
+            continue;
+        else if (argv[i][0] != '-' && hand_arg_count < 2)
+            hand_args[hand_arg_count++] = argv[i];
+        else
+            hand_arg_count = 0, i = argc;
+
+    uint8_t player[PLAY_CARD_COUNT], other[PLAY_CARD_COUNT];
+    Hand used = 0;
+    int other_known = 0;
+    if (hand_arg_count == 0 || cards_parse_arg(hand_args[0], player, PLAY_CARD_COUNT, &used) != PLAY_CARD_COUNT ||
+        (hand_args[1] && (other_known = cards_parse_arg(hand_args[1], other, PLAY_CARD_COUNT, &used)) < 0) ||
+        trials == 0)
+    {
+        printf("Usage: poker equity PLAYER [OTHER] [--trials N] [--seed S] [-j | --threads N]\n"
+               "  PLAYER is Player's 5 cards and OTHER up to 5 known cards of Other, as in \"AS KD 7C\";\n"
+               "  deals Other's unknown cards N times (default: %d) and reports Player's chances\n",
+               EQUITY_TRIALS);
+        return EXIT_FAILURE;
+    }
+
+    if ((size_t)threads > trials)
+        threads = trials;
+
+    eval_tables_init();
+
+    EquityJob job = {
+        .player_class = eval5_class(player[0], player[1], player[2], player[3], player[4]),
+        .other_known = other_known,
+    };
+    memcpy(job.other, other, other_known);
+    for (int card = 0; card < CARD_COUNT; card++)
+        if (!(used >> card & 1))
+            job.deck[job.deck_count++] = card;
+
+    double start = time_now();
+    EquityJob *jobs = malloc(threads * sizeof(EquityJob));
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    for (long t = 0; t < threads; t++)
+    {
+        // every thread works on its own copy of the deck with its own random sequence
+        jobs[t] = job;
+        jobs[t].seed = thread_seed(seed, t);
+        jobs[t].trials = trials / threads + ((size_t)t < trials % threads);
+        pthread_create(&workers[t], NULL, equity_worker, &jobs[t]);
+    }
+
+    size_t wins = 0, ties = 0, losses = 0;
+    for (long t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t], NULL);
+        wins += jobs[t].wins;
+        ties += jobs[t].ties;
+        losses += jobs[t].losses;
+    }
+    double elapsed = time_now() - start;
+
+    char player_text[3 * PLAY_CARD_COUNT + 1], other_text[3 * PLAY_CARD_COUNT + 1];
+    for (int i = 0; i < PLAY_CARD_COUNT; i++)
+    {
+        card_format(player[i], &player_text[3 * i]);
+        if (i < other_known)
+            card_format(other[i], &other_text[3 * i]);
+        else
+            memcpy(&other_text[3 * i], "??", 2);
+        player_text[3 * i + 2] = other_text[3 * i + 2] = ' ';
+    }
+    player_text[3 * PLAY_CARD_COUNT - 1] = other_text[3 * PLAY_CARD_COUNT - 1] = '\0';
+
+    double win = (double)wins / trials, tie = (double)ties / trials, loss = (double)losses / trials;
+    double equity = win + tie / 2;
+
+    int player_score = strength_to_score(class_strengths[job.player_class]);
+    printf("(Player) %s, Play = %s\n", player_text, score_to_play_string(player_score));
+    printf("(Other)  %s\n", other_text);
+    printf("%zu trials on %ld threads in %.2f s, %.1f M trials/s, 95%% confidence intervals:\n", trials, threads,
+           elapsed, trials / elapsed / 1e6);
+    // an equity of p per trial varies at most as much as a win or loss of share p, so the Wilson
+    // interval of a share p also covers it
+    equity_report("Win", win, trials);
+    equity_report("Tie", tie, trials);
+    equity_report("Loss", loss, trials);
+    equity_report("Equity", equity, trials);
+
+    free(jobs);
+    free(workers);
+
+    return EXIT_SUCCESS;
+}
+
+#ifdef POKER_FUZZER
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    (void)argc;
+    (void)argv;
+    eval_tables_init();
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
 {
-    if (a->score != b->score)
-        return a->score - b->score;
+    const char *pos = (const char *)data, *end = pos + size;
+    while (pos < end)
+    {
+        char report[FUZZ_REPORT_MAX];
+        if (!fuzz_check_parse(pos, end, report))
+        {
+            printf("%s", report);
+            fflush(stdout);
+            abort();
+        }
 
-    int play_vals_cmp_result = play_vals_cmp(a, b);
-    if (play_vals_cmp_result != 0)
-        return play_vals_cmp_result;
+        uint8_t cards[DEAL_CARD_COUNT];
+        if (parse_deal(&pos, end, cards) != DEAL_CARD_COUNT ||
+            __builtin_popcountll(hand_make(DEAL_CARD_COUNT, cards)) != DEAL_CARD_COUNT)
+            continue;
+
+        if (!fuzz_check_deal(cards, NULL, report))
+        {
+            printf("%s", report);
+            fflush(stdout);
+            abort();
+        }
+    }
 
-    return high_vals_cmp(a, b);
+    return 0;
 }
+#endif